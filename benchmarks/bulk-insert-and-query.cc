@@ -11,12 +11,14 @@
 //
 // for alg in `seq 0 1 14`; do for num in `seq 10 10 200`; do ./bulk-insert-and-query.exe ${num}000000 ${alg}; done; done > results.txt
 
+#include <atomic>
 #include <climits>
 #include <iomanip>
 #include <map>
 #include <stdexcept>
 #include <vector>
 #include <set>
+#include <thread>
 #include <stdio.h>
 
 // morton
@@ -25,27 +27,37 @@
 
 #include "cuckoofilter.h"
 #include "cuckoofilter_stable.h"
+#include "cuckoofilter_concurrent.h"
+#include "cuckoofilter_dynamic.h"
+#include "cuckoofilter_static.h"
 #include "xorfilter.h"
 #include "xorfilter_10bit.h"
 #include "xorfilter_13bit.h"
 #include "xorfilter_10_666bit.h"
+#include "xorfilter_fractional.h"
 #include "xorfilter_2.h"
 #include "xorfilter_2n.h"
 #include "xorfilter_plus.h"
 #include "xorfilter_singleheader.h"
 #include "xor_fuse_filter.h"
+#include "xor_retrieval.h"
+#include "binaryfusefilter.h"
 #include "bloom.h"
 #include "counting_bloom.h"
 #include "gcs.h"
+#include "ribbon.h"
 #ifdef __AVX2__
 #include "gqf_cpp.h"
 #include "simd-block.h"
 #endif
 #include "random.h"
+#include "replicated.h"
 #include "simd-block-fixed-fpp.h"
 #include "timing.h"
 #ifdef __linux__
 #include "linux-perf-events.h"
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 using namespace std;
@@ -56,9 +68,11 @@ using namespace xorfilter2;
 using namespace xorfilter2n;
 using namespace xorfilter_plus;
 using namespace xorfusefilter;
+using namespace binaryfusefilter;
 using namespace bloomfilter;
 using namespace counting_bloomfilter;
 using namespace gcsfilter;
+using namespace ribbonfilter;
 using namespace CompressedCuckoo; // Morton filter namespace
 #ifdef __AVX2__
 using namespace gqfilter;
@@ -67,6 +81,9 @@ using namespace gqfilter;
 // The number of items sampled when determining the lookup performance
 const size_t MAX_SAMPLE_SIZE = 10 * 1000 * 1000;
 
+// The number of threads used for lookups (see --threads)
+size_t lookup_threads = 1;
+
 // The statistics gathered for each table type:
 struct Statistics {
   size_t add_count;
@@ -186,6 +203,68 @@ struct FilterAPI<CuckooFilterStable<ItemType, bits_per_item, TableType, HashFami
 };
 
 
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+struct FilterAPI<CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>> {
+  using Table = CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table * table) {
+    if (0 != table->Add(key)) {
+      throw logic_error("The filter is too small to hold all of the elements");
+    }
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void Remove(uint64_t key, Table * table) {
+    table->Delete(key);
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+// starts at a tenth of the size, and grows while the keys are added
+template <typename ItemType, size_t bits_per_item, template <size_t> class TableType, typename HashFamily>
+struct FilterAPI<CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>> {
+  using Table = CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count / 10); }
+  static void Add(uint64_t key, Table * table) {
+    if (0 != table->Add(key)) {
+      throw logic_error("The filter is too small to hold all of the elements");
+    }
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void Remove(uint64_t key, Table * table) {
+    table->Delete(key);
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+struct FilterAPI<CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>> {
+  using Table = CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    if (0 != table->AddAll(keys, start, end)) {
+      throw logic_error("The filter is too small to hold all of the elements");
+    }
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
 #ifdef __aarch64__
 template <typename HashFamily>
 struct FilterAPI<SimdBlockFilterFixed<HashFamily>> {
@@ -317,6 +396,46 @@ struct FilterAPI<XorFilter<ItemType, FingerprintType>> {
   }
 };
 
+template <typename ItemType, typename FingerprintType, typename HashFamily, int Arity>
+struct FilterAPI<BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>> {
+  using Table = BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    if (table->AddAll(keys, start, end) != binaryfusefilter::Ok) {
+      throw logic_error("Could not build the filter");
+    }
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+template <typename ItemType, int bits, typename CoeffType, typename HashFamily>
+struct FilterAPI<RibbonFilter<ItemType, bits, CoeffType, HashFamily>> {
+  using Table = RibbonFilter<ItemType, bits, CoeffType, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    if (table->AddAll(keys, start, end) != ribbonfilter::Ok) {
+      throw logic_error("Could not build the filter");
+    }
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
 template <typename ItemType, typename FingerprintType>
 struct FilterAPI<XorFuseFilter<ItemType, FingerprintType>> {
   using Table = XorFuseFilter<ItemType, FingerprintType>;
@@ -335,6 +454,40 @@ struct FilterAPI<XorFuseFilter<ItemType, FingerprintType>> {
   }
 };
 
+// fuse filter with one shard per hardware thread, built in parallel
+template <typename FingerprintType>
+class XorFuseParallel : public XorFuseFilter<uint64_t, FingerprintType> {
+public:
+    explicit XorFuseParallel(const size_t size)
+        : XorFuseFilter<uint64_t, FingerprintType>(size, Threads()) {}
+    xorfusefilter::Status AddAll(const vector<uint64_t> &keys, const size_t start, const size_t end) {
+        return XorFuseFilter<uint64_t, FingerprintType>::AddAll(
+            keys.data(), start, end, Threads());
+    }
+    static size_t Threads() {
+        size_t threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : threads;
+    }
+};
+
+template <typename FingerprintType>
+struct FilterAPI<XorFuseParallel<FingerprintType>> {
+  using Table = XorFuseParallel<FingerprintType>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    table->AddAll(keys, start, end);
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
 class MortonFilter {
     Morton3_8* filter;
     size_t size;
@@ -413,6 +566,9 @@ public:
     inline bool Contain(uint64_t &item) const {
         return xor8_contain(item, &filter);
     }
+    inline uint8_t Contain8(const uint64_t* items) const {
+        return xor8_contain8(items, &filter);
+    }
     inline size_t SizeInBytes() const {
         return xor8_size_in_bytes(&filter);
     }
@@ -444,6 +600,37 @@ struct FilterAPI<XorSingle> {
     }
 };
 
+// xor filter built with one thread per hardware thread
+template <typename FingerprintType>
+class XorParallel : public XorFilter<uint64_t, FingerprintType, SimpleMixSplit> {
+public:
+    explicit XorParallel(const size_t size)
+        : XorFilter<uint64_t, FingerprintType, SimpleMixSplit>(size) {}
+    xorfilter::Status AddAll(const vector<uint64_t> &keys, const size_t start, const size_t end) {
+        size_t threads = std::thread::hardware_concurrency();
+        return XorFilter<uint64_t, FingerprintType, SimpleMixSplit>::AddAll(
+            keys.data(), start, end, threads == 0 ? 1 : threads);
+    }
+};
+
+template <typename FingerprintType>
+struct FilterAPI<XorParallel<FingerprintType>> {
+  using Table = XorParallel<FingerprintType>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    table->AddAll(keys, start, end);
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
 template<size_t blocksize, int k, typename HashFamily>
 struct FilterAPI<SimpleBlockFilter<blocksize,k,HashFamily>> {
   using Table = SimpleBlockFilter<blocksize,k,HashFamily>;
@@ -556,6 +743,54 @@ struct FilterAPI<XorFilter10_666<ItemType, HashFamily>> {
   }
 };
 
+template <typename ItemType, int fingerprintsPerWord, typename WordType, typename HashFamily>
+struct FilterAPI<XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>> {
+  using Table = XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    table->AddAll(keys, start, end);
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return (0 == table->Contain(key));
+  }
+};
+
+// benchmarks the retrieval map as a filter: the value of a key is a
+// fingerprint derived from the key, and a key is found if its value matches
+template <typename ItemType, int valueBits, typename HashFamily>
+struct FilterAPI<XorRetrieval<ItemType, valueBits, HashFamily>> {
+  using Table = XorRetrieval<ItemType, valueBits, HashFamily>;
+  static uint32_t Value(uint64_t key) {
+    return (uint32_t) SimpleMixSplit::murmur64(key) &
+           (uint32_t) ((UINT64_C(1) << valueBits) - 1);
+  }
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<ItemType> keys, const size_t start, const size_t end, Table* table) {
+    vector<uint32_t> values(end);
+    for (size_t i = start; i < end; i++) {
+      values[i] = Value(keys[i]);
+    }
+    if (table->AddAll(keys, values, start, end) != 0) {
+      throw logic_error("Could not build the filter");
+    }
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return table->Get(key) == Value(key);
+  }
+};
+
 template <typename ItemType, typename FingerprintType, typename FingerprintStorageType, typename HashFamily>
 struct FilterAPI<XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily>> {
   using Table = XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily>;
@@ -722,87 +957,415 @@ struct FilterAPI<SuccinctCountingBlockedBloomRankFilter<ItemType, bits_per_item,
   }
 };
 
-// assuming that first1,last1 and first2, last2 are sorted,
-// this tries to find out how many of first1,last1 can be
-// found in first2, last2, this includes duplicates
-template<class InputIt1, class InputIt2>
-size_t match_size_iter(InputIt1 first1, InputIt1 last1,
-                          InputIt2 first2, InputIt2 last2) {
-    size_t answer = 0;
-    while (first1 != last1 && first2 != last2) {
-        if (*first1 < *first2) {
-            ++first1;
-        } else  if (*first2 < *first1) {
-            ++first2;
-        } else {
-            answer ++;
-            ++first1;
-        }
-    }
-    return answer;
-}
-
-template<class InputIt>
-size_t count_distinct(InputIt first, InputIt last) {
-    if(last  == first) return 0;
-    size_t answer = 1;
-    auto val = *first;
-    first++;
+// benchmarks the lookup using ContainBatch instead of Contain
+template <typename Filter>
+class Batched : public Filter {
+public:
+    explicit Batched(const size_t size) : Filter(size) {}
+};
 
-    while (first != last) {
-      if(val != *first) ++answer;
-      first++;
-    }
-    return answer;
-}
+template <typename Filter>
+struct FilterAPI<Batched<Filter>> {
+  using Table = Batched<Filter>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    FilterAPI<Filter>::Add(key, table);
+  }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    FilterAPI<Filter>::AddAll(keys, start, end, table);
+  }
+  static void Remove(uint64_t key, Table * table) {
+    FilterAPI<Filter>::Remove(key, table);
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return FilterAPI<Filter>::Contain(key, table);
+  }
+};
 
-size_t match_size(vector<uint64_t> a,  vector<uint64_t> b, size_t * distincta, size_t * distinctb) {
-  // could obviously be accelerated with a Bloom filter
-  // But this is surprisingly fast!
-  vector<uint64_t> result;
-  std::sort(a.begin(), a.end());
-  std::sort(b.begin(), b.end());
-  if(distincta != NULL) *distincta  = count_distinct(a.begin(), a.end());
-  if(distinctb != NULL) *distinctb  = count_distinct(b.begin(), b.end());
-  return match_size_iter(a.begin(), a.end(),b.begin(), b.end());
-}
+// benchmarks the lookup using Contain8 (8 keys per call) instead of Contain
+template <typename Filter>
+class Simd : public Filter {
+public:
+    explicit Simd(const size_t size) : Filter(size) {}
+};
 
-bool has_duplicates(vector<uint64_t> a) {
-  std::sort(a.begin(), a.end());
-  return count_distinct(a.begin(), a.end()) < a.size();
-}
-struct samples {
-  double found_probability;
-  std::vector<uint64_t> to_lookup_mixed;
-  size_t true_match;
-  size_t actual_sample_size;
+template <typename Filter>
+struct FilterAPI<Simd<Filter>> {
+  using Table = Simd<Filter>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    FilterAPI<Filter>::Add(key, table);
+  }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    FilterAPI<Filter>::AddAll(keys, start, end, table);
+  }
+  static void Remove(uint64_t key, Table * table) {
+    FilterAPI<Filter>::Remove(key, table);
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return FilterAPI<Filter>::Contain(key, table);
+  }
 };
 
-typedef struct samples samples_t;
+// benchmarks the construction using AddAllSorted instead of AddAll
+template <typename Filter>
+class Sorted : public Filter {
+public:
+    explicit Sorted(const size_t size) : Filter(size) {}
+};
 
-template <typename Table>
-Statistics FilterBenchmark(
-    size_t add_count, const vector<uint64_t>& to_add, size_t distinct_add, const vector<uint64_t>& to_lookup, size_t distinct_lookup,
-    size_t intersectionsize, bool hasduplicates,
-    const std::vector<samples_t> & mixed_sets, int seed, bool batchedadd = false, bool remove = false) {
-  if (add_count > to_add.size()) {
-    throw out_of_range("to_add must contain at least add_count values");
+template <typename Filter>
+struct FilterAPI<Sorted<Filter>> {
+  using Table = Sorted<Filter>;
+  static Table ConstructFromAddCount(size_t add_count) { return Table(add_count); }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
   }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    if (table->AddAllSorted(keys.data(), start, end) != 0) {
+      throw logic_error("Could not build the filter");
+    }
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return FilterAPI<Filter>::Contain(key, table);
+  }
+};
 
-
-  Table filter = FilterAPI<Table>::ConstructFromAddCount(add_count);
-  Statistics result;
-#ifdef __linux__
-  vector<int> evts;
-  evts.push_back(PERF_COUNT_HW_CPU_CYCLES);
-  evts.push_back(PERF_COUNT_HW_INSTRUCTIONS);
+// benchmarks the lookup with one copy of the filter per NUMA node; the
+// filter is moved into the primary copy, and copied to the other nodes
+// once it is built
+template <typename Filter>
+struct FilterAPI<allocation::Replicated<Filter>> {
+  using Table = allocation::Replicated<Filter>;
+  static Table ConstructFromAddCount(size_t add_count) {
+    return Table(FilterAPI<Filter>::ConstructFromAddCount(add_count));
+  }
+  static void Add(uint64_t key, Table* table) {
+    throw std::runtime_error("Unsupported");
+  }
+  static void AddAll(const vector<uint64_t> keys, const size_t start, const size_t end, Table* table) {
+    FilterAPI<Filter>::AddAll(keys, start, end, &table->Primary());
+    table->Replicate();
+  }
+  static void Remove(uint64_t key, Table * table) {
+    throw std::runtime_error("Unsupported");
+  }
+  CONTAIN_ATTRIBUTES static bool Contain(uint64_t key, const Table * table) {
+    return FilterAPI<Filter>::Contain(key, &table->Local());
+  }
+};
+
+// number of keys found in the filter
+template <typename Table>
+size_t CountFound(const vector<uint64_t> &keys, Table * table) {
+  size_t found_count = 0;
+  for (const auto v : keys) {
+    found_count += FilterAPI<Table>::Contain(v, table);
+  }
+  return found_count;
+}
+
+template <typename Filter>
+size_t CountFound(const vector<uint64_t> &keys, Batched<Filter> * table) {
+  const size_t block = 1024;
+  uint8_t out[block];
+  size_t found_count = 0;
+  for (size_t start = 0; start < keys.size(); start += block) {
+    size_t len = std::min(block, keys.size() - start);
+    table->ContainBatch(keys.data() + start, len, out);
+    for (size_t i = 0; i < len; i++) {
+      found_count += out[i];
+    }
+  }
+  return found_count;
+}
+
+template <typename Filter>
+size_t CountFound(const vector<uint64_t> &keys, Simd<Filter> * table) {
+  size_t found_count = 0;
+  size_t i = 0;
+  for (; i + 8 <= keys.size(); i += 8) {
+    found_count += __builtin_popcount(table->Contain8(keys.data() + i));
+  }
+  for (; i < keys.size(); i++) {
+    found_count += FilterAPI<Filter>::Contain(keys[i], table);
+  }
+  return found_count;
+}
+
+#ifdef __linux__
+// the CPUs this process may run on
+vector<int> AllowedCpus() {
+  vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &set)) {
+        cpus.push_back(i);
+      }
+    }
+  }
+  return cpus;
+}
+
+void PinThread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif
+
+// The result of looking up keys from multiple threads.
+struct ThreadedLookup {
+  size_t found_count;
+  // from the first thread starting to the last thread finishing
+  uint64_t nanos;
+  // the average time per query of a thread
+  double nanos_per_query_per_thread;
+  // perf counters summed over all threads
+  vector<unsigned long long> counters;
+  vector<unsigned long long> tlb_counters;
+};
+
+// Look up the keys from lookup_threads threads, each pinned to its own CPU
+// and querying a disjoint slice of the keys. All threads start together,
+// so that they compete for memory bandwidth like concurrent readers of a
+// shared filter do.
+template <typename Table>
+ThreadedLookup CountFoundThreaded(const vector<uint64_t> &keys, Table * table,
+    const vector<int> &evts, const vector<int> &tlbEvts) {
+  const size_t threads = lookup_threads;
+  vector<vector<uint64_t>> slices(threads);
+  for (size_t t = 0; t < threads; t++) {
+    slices[t].assign(keys.begin() + keys.size() * t / threads,
+                     keys.begin() + keys.size() * (t + 1) / threads);
+  }
+  vector<size_t> found(threads);
+  vector<uint64_t> starts(threads), ends(threads);
+  vector<vector<unsigned long long>> counters(threads), tlbCounters(threads);
+#ifdef __linux__
+  const vector<int> cpus = AllowedCpus();
+#endif
+  atomic<size_t> ready(0);
+  auto worker = [&](size_t t) {
+#ifdef __linux__
+    if (!cpus.empty()) {
+      PinThread(cpus[t % cpus.size()]);
+    }
+    // the counters only count the thread that opens them
+    LinuxEvents<PERF_TYPE_HARDWARE> unified(evts);
+    LinuxEvents<PERF_TYPE_HW_CACHE> tlb(tlbEvts);
+    counters[t].resize(evts.size());
+    tlbCounters[t].resize(tlbEvts.size());
+#endif
+    ready++;
+    while (ready.load() < threads) {
+      this_thread::yield();
+    }
+#ifdef __linux__
+    unified.start();
+    tlb.start();
+#endif
+    starts[t] = NowNanos();
+    found[t] = CountFound(slices[t], table);
+    ends[t] = NowNanos();
+#ifdef __linux__
+    unified.end(counters[t]);
+    tlb.end(tlbCounters[t]);
+#endif
+  };
+  vector<thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back(worker, t);
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  ThreadedLookup result;
+  result.found_count = 0;
+  result.counters.assign(evts.size(), 0);
+  result.tlb_counters.assign(tlbEvts.size(), 0);
+  double per_thread = 0;
+  for (size_t t = 0; t < threads; t++) {
+    result.found_count += found[t];
+    if (!slices[t].empty()) {
+      per_thread += static_cast<double>(ends[t] - starts[t]) / slices[t].size();
+    }
+    for (size_t i = 0; i < counters[t].size(); i++) {
+      result.counters[i] += counters[t][i];
+    }
+    for (size_t i = 0; i < tlbCounters[t].size(); i++) {
+      result.tlb_counters[i] += tlbCounters[t][i];
+    }
+  }
+  result.nanos = *max_element(ends.begin(), ends.end()) -
+                 *min_element(starts.begin(), starts.end());
+  result.nanos_per_query_per_thread = per_thread / threads;
+  return result;
+}
+
+// Add and look up keys from max(lookup_threads, 2) threads at the same
+// time, each pinned to its own CPU. Half of the keys are added first; the
+// threads then add the other half, a disjoint slice each, interleaved with
+// lookups so that writePercent of the operations are adds. Returns the
+// number of operations per microsecond (million per second) of all threads
+// together.
+template <typename Table>
+double MixedThreaded(size_t add_count, const vector<uint64_t> &to_add,
+                     const vector<uint64_t> &to_lookup, size_t writePercent) {
+  const size_t threads = max(lookup_threads, (size_t) 2);
+  Table filter = FilterAPI<Table>::ConstructFromAddCount(add_count);
+  const size_t initial = add_count / 2;
+  for (size_t i = 0; i < initial; i++) {
+    FilterAPI<Table>::Add(to_add[i], &filter);
+  }
+  vector<size_t> found(threads), ops(threads);
+#ifdef __linux__
+  const vector<int> cpus = AllowedCpus();
+#endif
+  atomic<size_t> ready(0);
+  auto worker = [&](size_t t) {
+#ifdef __linux__
+    if (!cpus.empty()) {
+      PinThread(cpus[t % cpus.size()]);
+    }
+#endif
+    size_t next = initial + (add_count - initial) * t / threads;
+    const size_t last = initial + (add_count - initial) * (t + 1) / threads;
+    size_t lookup = to_lookup.size() * t / threads;
+    ready++;
+    while (ready.load() < threads) {
+      this_thread::yield();
+    }
+    size_t j = 0;
+    for (; next < last; j++) {
+      if ((j * writePercent) % 100 < writePercent) {
+        FilterAPI<Table>::Add(to_add[next++], &filter);
+      } else {
+        found[t] += FilterAPI<Table>::Contain(to_lookup[lookup], &filter);
+        lookup = lookup + 1 == to_lookup.size() ? 0 : lookup + 1;
+      }
+    }
+    ops[t] = j;
+  };
+  const auto start_time = NowNanos();
+  vector<thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back(worker, t);
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  const auto time = NowNanos() - start_time;
+  for (size_t i = 0; i < add_count; i++) {
+    if (!FilterAPI<Table>::Contain(to_add[i], &filter)) {
+      cerr << "ERROR: a key added concurrently was not found" << endl;
+      cerr << "ERROR: This is a potential bug!" << endl;
+      break;
+    }
+  }
+  size_t total = 0;
+  for (size_t t = 0; t < threads; t++) {
+    total += ops[t];
+  }
+  return total * 1000.0 / time;
+}
+
+// assuming that first1,last1 and first2, last2 are sorted,
+// this tries to find out how many of first1,last1 can be
+// found in first2, last2, this includes duplicates
+template<class InputIt1, class InputIt2>
+size_t match_size_iter(InputIt1 first1, InputIt1 last1,
+                          InputIt2 first2, InputIt2 last2) {
+    size_t answer = 0;
+    while (first1 != last1 && first2 != last2) {
+        if (*first1 < *first2) {
+            ++first1;
+        } else  if (*first2 < *first1) {
+            ++first2;
+        } else {
+            answer ++;
+            ++first1;
+        }
+    }
+    return answer;
+}
+
+template<class InputIt>
+size_t count_distinct(InputIt first, InputIt last) {
+    if(last  == first) return 0;
+    size_t answer = 1;
+    auto val = *first;
+    first++;
+
+    while (first != last) {
+      if(val != *first) ++answer;
+      first++;
+    }
+    return answer;
+}
+
+size_t match_size(vector<uint64_t> a,  vector<uint64_t> b, size_t * distincta, size_t * distinctb) {
+  // could obviously be accelerated with a Bloom filter
+  // But this is surprisingly fast!
+  vector<uint64_t> result;
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  if(distincta != NULL) *distincta  = count_distinct(a.begin(), a.end());
+  if(distinctb != NULL) *distinctb  = count_distinct(b.begin(), b.end());
+  return match_size_iter(a.begin(), a.end(),b.begin(), b.end());
+}
+
+bool has_duplicates(vector<uint64_t> a) {
+  std::sort(a.begin(), a.end());
+  return count_distinct(a.begin(), a.end()) < a.size();
+}
+struct samples {
+  double found_probability;
+  std::vector<uint64_t> to_lookup_mixed;
+  size_t true_match;
+  size_t actual_sample_size;
+};
+
+typedef struct samples samples_t;
+
+template <typename Table>
+Statistics FilterBenchmark(
+    size_t add_count, const vector<uint64_t>& to_add, size_t distinct_add, const vector<uint64_t>& to_lookup, size_t distinct_lookup,
+    size_t intersectionsize, bool hasduplicates,
+    const std::vector<samples_t> & mixed_sets, int seed, bool batchedadd = false, bool remove = false) {
+  if (add_count > to_add.size()) {
+    throw out_of_range("to_add must contain at least add_count values");
+  }
+
+
+  Table filter = FilterAPI<Table>::ConstructFromAddCount(add_count);
+  Statistics result;
+  vector<int> evts;
+  vector<int> tlbEvts;
+#ifdef __linux__
+  evts.push_back(PERF_COUNT_HW_CPU_CYCLES);
+  evts.push_back(PERF_COUNT_HW_INSTRUCTIONS);
   evts.push_back(PERF_COUNT_HW_CACHE_MISSES);
   evts.push_back(PERF_COUNT_HW_BRANCH_MISSES);
   LinuxEvents<PERF_TYPE_HARDWARE> unified(evts);
   vector<unsigned long long> results;
   results.resize(evts.size());
+  // dTLB load misses, to see the effect of huge pages
+  tlbEvts.push_back(PERF_COUNT_HW_CACHE_DTLB |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  LinuxEvents<PERF_TYPE_HW_CACHE> tlb(tlbEvts);
+  vector<unsigned long long> tlbResults;
+  tlbResults.resize(tlbEvts.size());
   cout << endl;
   unified.start();
+  tlb.start();
 #else
    std::cout << "-" << std::flush;
 #endif
@@ -825,13 +1388,15 @@ Statistics FilterBenchmark(
   std::cout << "\r             \r" << std::flush;
 #ifdef __linux__
   unified.end(results);
+  tlb.end(tlbResults);
   printf("add    ");
-  printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key\n",
+  printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key dTLB misses: %5.2f/key\n",
     results[0]*1.0/add_count,
     results[1]*1.0/add_count ,
     results[1]*1.0/results[0],
     results[2]*1.0/add_count,
-    results[3]*1.0/add_count);
+    results[3]*1.0/add_count,
+    tlbResults[0]*1.0/add_count);
 #else
   std::cout << "." << std::flush;
 #endif
@@ -851,26 +1416,56 @@ Statistics FilterBenchmark(
     const auto to_lookup_mixed =  t.to_lookup_mixed ;
     size_t true_match = t.true_match ;
 
+    if (lookup_threads > 1) {
+      ThreadedLookup lookup = CountFoundThreaded(to_lookup_mixed, &filter, evts, tlbEvts);
+      found_count = lookup.found_count;
+      printf("%3.2f%%  ", found_probability);
+      printf("threads: %zu, %7.2f million queries/s, %6.2f ns/query per thread\n",
+        lookup_threads,
+        to_lookup_mixed.size() * 1000.0 / lookup.nanos,
+        lookup.nanos_per_query_per_thread);
+#ifdef __linux__
+      printf("       ");
+      printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key dTLB misses: %5.2f/key (all threads)\n",
+        lookup.counters[0]*1.0/to_lookup_mixed.size(),
+        lookup.counters[1]*1.0/to_lookup_mixed.size(),
+        lookup.counters[1]*1.0/lookup.counters[0],
+        lookup.counters[2]*1.0/to_lookup_mixed.size(),
+        lookup.counters[3]*1.0/to_lookup_mixed.size(),
+        lookup.tlb_counters[0]*1.0/to_lookup_mixed.size());
+#endif
+      if (found_count < true_match) {
+             cerr << "ERROR: Expected to find at least " << true_match << " found " << found_count << endl;
+             cerr << "ERROR: This is a potential bug!" << endl;
+      }
+      // the time per query of all threads together
+      result.nanos_per_finds[100 * found_probability] =
+          static_cast<double>(lookup.nanos) / t.actual_sample_size;
+      if (0.0 == found_probability) {
+        result.false_positive_probabilty = (found_count  - intersectionsize) / static_cast<double>(to_lookup_mixed.size() - intersectionsize);
+      }
+      continue;
+    }
 #ifdef __linux__
     unified.start();
+    tlb.start();
 #else
     std::cout << "-" << std::flush;
 #endif
     const auto start_time = NowNanos();
-    found_count = 0;
-    for (const auto v : to_lookup_mixed) {
-      found_count += FilterAPI<Table>::Contain(v, &filter);
-    }
+    found_count = CountFound(to_lookup_mixed, &filter);
     const auto lookup_time = NowNanos() - start_time;
 #ifdef __linux__
     unified.end(results);
+    tlb.end(tlbResults);
     printf("%3.2f%%  ",found_probability);
-    printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key\n",
+    printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key dTLB misses: %5.2f/key\n",
       results[0]*1.0/to_lookup_mixed.size(),
       results[1]*1.0/to_lookup_mixed.size(),
       results[1]*1.0/results[0],
       results[2]*1.0/to_lookup_mixed.size(),
-      results[3] * 1.0/to_lookup_mixed.size());
+      results[3] * 1.0/to_lookup_mixed.size(),
+      tlbResults[0] * 1.0/to_lookup_mixed.size());
 #else
     std::cout << "." << std::flush;
 #endif
@@ -902,6 +1497,7 @@ Statistics FilterBenchmark(
     std::cout << "1-by-1 remove" << std::flush;
 #ifdef __linux__
     unified.start();
+    tlb.start();
 #else
     std::cout << "-" << std::flush;
 #endif
@@ -913,13 +1509,15 @@ Statistics FilterBenchmark(
     result.nanos_per_remove = static_cast<double>(time) / add_count;
 #ifdef __linux__
     unified.end(results);
+    tlb.end(tlbResults);
     printf("remove ");
-    printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key\n",
+    printf("cycles: %5.1f/key, instructions: (%5.1f/key, %4.2f/cycle) cache misses: %5.2f/key branch misses: %4.2f/key dTLB misses: %5.2f/key\n",
       results[0]*1.0/add_count,
       results[1]*1.0/add_count ,
       results[1]*1.0/results[0],
       results[2]*1.0/add_count,
-      results[3]*1.0/add_count);
+      results[3]*1.0/add_count,
+      tlbResults[0]*1.0/add_count);
 #else
     std::cout << "." << std::flush;
 #endif
@@ -1001,19 +1599,76 @@ int main(int argc, char * argv[]) {
     {63, "SuccCountBlockBloomRank10"},
 
     {70, "Xor8-singleheader"},
+    {71, "Xor8 (parallel)"}, {72, "Xor16 (parallel)"},
+    {73, "Xor8 (batch)"}, {74, "Xor16 (batch)"}, {75, "Xor+8 (batch)"},
+    {76, "Xor12 (batch)"}, {77, "Xor10.666 (batch)"}, {78, "Xor8-2^n (batch)"},
     {80, "Morton"},
+    {81, "Xor8 (replicated)"},
+#ifdef __AVX2__
+    {82, "BlockedBloom (replicated)"},
+#endif
+    {83, "BinaryFuse8"}, {84, "BinaryFuse16"},
+    {85, "BinaryFuse8 (4-wise)"}, {86, "BinaryFuse16 (4-wise)"},
+    {87, "BinaryFuse8 (sorted)"}, {88, "BinaryFuse8 (4-wise, sorted)"},
+    {89, "XorFuse8 (sorted)"},
 
     {90, "XorFuse8"},
     {91, "XorFuse16"},
+    {92, "XorFuse8 (parallel)"},
+    {93, "XorFuse16 (parallel)"},
+    {94, "XorFuse8 (batch)"},
+    {95, "XorFuse16 (batch)"},
+    {96, "Xor8 (simd)"},
+    {97, "Xor16 (simd)"},
+    {98, "Xor8-singleheader (simd)"},
 
     // Sort
     {100, "Sort"},
+
+    {101, "Ribbon8 (w64)"}, {102, "Ribbon8 (w128)"}, {103, "Ribbon7 (w128)"},
+    {104, "Xor9 (packed)"}, {105, "Xor10 (packed)"}, {106, "Xor20 (packed)"},
+    {107, "Xor6.4 (fractional)"}, {108, "Xor9.14 (fractional)"},
+    {109, "Xor10.666 (fractional)"}, {110, "Xor12.8 (fractional)"},
+    {111, "Xor16 (fractional)"},
+    {112, "Cuckoo8 (concurrent)"}, {113, "Cuckoo12 (concurrent)"},
+    {114, "Cuckoo16 (concurrent)"},
+    {115, "Cuckoo12 (dynamic)"}, {116, "Cuckoo16 (dynamic)"},
+    {117, "Cuckoo12 (batch)"}, {118, "Cuckoo16 (batch)"},
+    {119, "CuckooSemiSort13 (batch)"}, {120, "Cuckoo12-2^n (batch)"},
+    {121, "Cuckoo16-2^n (batch)"}, {122, "CuckooSemiSort13-2^n (batch)"},
+    {123, "Cuckoo16-8way"}, {124, "Cuckoo16-16way"},
+    {125, "Cuckoo16-8way (batch)"},
+    {126, "Cuckoo12 (static)"}, {127, "CuckooSemiSort13 (static)"},
+    {128, "Cuckoo16-8way (static)"}, {129, "Cuckoo16-8way (static, batch)"},
+    {130, "XorRetrieval8 (as filter)"},
+    {131, "Cuckoo12 (concurrent, 10% add)"},
+    {132, "Cuckoo12 (concurrent, 50% add)"},
   };
 
   // Parameter Parsing ----------------------------------------------------------
 
+  // options, removed from the arguments
+  int positional = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      stringstream threads_string(argv[++i]);
+      threads_string >> lookup_threads;
+      if (threads_string.fail() || lookup_threads == 0) {
+        cerr << "Invalid number of threads: " << argv[i];
+        return 2;
+      }
+    } else {
+      argv[positional++] = argv[i];
+    }
+  }
+  argc = positional;
+
   if (argc < 2) {
-    cout << "Usage: " << argv[0] << " <numberOfEntries> [<algorithmId> [<seed>]]" << endl;
+    cout << "Usage: " << argv[0] << " [--threads <threads>] <numberOfEntries> [<algorithmId> [<seed> [<allocation> [<placement>]]]]" << endl;
+    cout << " threads: number of threads for the lookups (default 1); each thread is pinned to a CPU" << endl;
+    cout << "          and queries a disjoint slice of the keys; the find columns are then the" << endl;
+    cout << "          wall-clock time per query of all threads together; the entries with concurrent" << endl;
+    cout << "          adds use at least 2 threads" << endl;
     cout << " numberOfEntries: number of keys, we recommend at least 100000000" << endl;
     cout << " algorithmId: -1 for all default algos, or 0..n to only run this algorithm" << endl;
     cout << " algorithmId: can also be a comma-separated list of non-negative integers" << endl;
@@ -1022,6 +1677,9 @@ int main(int argc, char * argv[]) {
     }
     cout << " algorithmId: can also be set to the string 'all' if you want to run them all, including some that are excluded by default" << endl;
     cout << " seed: seed for the PRNG; -1 for random seed (default)" << endl;
+    cout << " allocation: memory for the filter tables: heap (default), thp (transparent huge pages)," << endl;
+    cout << "             2mb or 1gb (hugetlbfs pages, which must be reserved)" << endl;
+    cout << " placement: NUMA placement of the filter tables: local (default), or interleave (over all nodes)" << endl;
     return 1;
   }
   stringstream input_string(argv[1]);
@@ -1065,6 +1723,22 @@ int main(int argc, char * argv[]) {
           return 2;
       }
   }
+  if (argc > 4) {
+      allocation::Policy policy;
+      if (!allocation::parsePolicy(argv[4], &policy)) {
+          cerr << "Invalid allocation: " << argv[4];
+          return 2;
+      }
+      allocation::setDefaultPolicy(policy);
+  }
+  if (argc > 5) {
+      if (strcmp(argv[5], "interleave") == 0) {
+          allocation::setDefaultInterleave(true);
+      } else if (strcmp(argv[5], "local") != 0) {
+          cerr << "Invalid placement: " << argv[5];
+          return 2;
+      }
+  }
   size_t actual_sample_size = MAX_SAMPLE_SIZE;
   if (actual_sample_size > add_count) {
     actual_sample_size = add_count;
@@ -1470,6 +2144,63 @@ int main(int argc, char * argv[]) {
       cout << setw(NAME_WIDTH) << names[a] << cf << endl;
   }
 
+  a = 71;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorParallel<uint8_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 72;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorParallel<uint16_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 73;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilter<uint64_t, uint8_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 74;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilter<uint64_t, uint16_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 75;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilterPlus<uint64_t, uint8_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 76;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilter2<uint64_t, uint32_t, UInt12Array, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 77;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilter10_666<uint64_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 78;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFilter2n<uint64_t, uint8_t, UIntArray<uint8_t>, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
   a = 80;
   if (algorithmId == a || (algos.find(a) != algos.end())) {
       auto cf = FilterBenchmark<
@@ -1478,6 +2209,76 @@ int main(int argc, char * argv[]) {
       cout << setw(NAME_WIDTH) << names[a] << cf << endl;
   }
 
+  // Replicated ----------------------------------------------------------
+  a = 81;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<allocation::Replicated<
+          XorFilter<uint64_t, uint8_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+#ifdef __AVX2__
+  a = 82;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<allocation::Replicated<
+          SimdBlockFilterFixed<SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+#endif
+
+  // Binary Fuse Filter ----------------------------------------------------------
+  a = 83;
+  if (algorithmId == a || algorithmId < 0 || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          BinaryFuseFilter<uint64_t, uint8_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 84;
+  if (algorithmId == a || algorithmId < 0 || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          BinaryFuseFilter<uint64_t, uint16_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 85;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          BinaryFuseFilter<uint64_t, uint8_t, TwoIndependentMultiplyShift, 4>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 86;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          BinaryFuseFilter<uint64_t, uint16_t, TwoIndependentMultiplyShift, 4>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  a = 87;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Sorted<BinaryFuseFilter<uint64_t, uint8_t>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 88;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Sorted<BinaryFuseFilter<uint64_t, uint8_t, TwoIndependentMultiplyShift, 4>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 89;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Sorted<XorFuseFilter<uint64_t, uint8_t>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
   // Xor Fuse Filter ----------------------------------------------------------
   a = 90;
   if (algorithmId == a || algorithmId < 0 || (algos.find(a) != algos.end())) {
@@ -1493,6 +2294,295 @@ int main(int argc, char * argv[]) {
           add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
       cout << setw(NAME_WIDTH) << names[a] << cf << endl;
   }
+  a = 92;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFuseParallel<uint8_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 93;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFuseParallel<uint16_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 94;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFuseFilter<uint64_t, uint8_t>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 95;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<XorFuseFilter<uint64_t, uint16_t>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 96;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Simd<XorFilter<uint64_t, uint8_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 97;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Simd<XorFilter<uint64_t, uint16_t, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 98;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Simd<XorSingle>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  // Ribbon Filter ----------------------------------------------------------
+  a = 101;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          RibbonFilter<uint64_t, 8>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 102;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          RibbonFilter<uint64_t, 8, __uint128_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 103;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          RibbonFilter<uint64_t, 7, __uint128_t>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Xor Filter with packed fingerprints of any width ------------------------
+  a = 104;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilter2<uint64_t, uint16_t, PackedBitArray<9>, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 105;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilter2<uint64_t, uint16_t, PackedBitArray<10>, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 106;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilter2<uint64_t, uint32_t, PackedBitArray<20>, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Xor Filter with fractional fingerprint sizes ---------------------------
+  a = 107;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilterFractional<uint64_t, 5, uint32_t, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 108;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilterFractional<uint64_t, 7, uint64_t, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 109;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilterFractional<uint64_t, 3, uint32_t, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 110;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilterFractional<uint64_t, 5, uint64_t, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 111;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorFilterFractional<uint64_t, 4, uint64_t, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Cuckoo Filter with concurrent readers and writers ---------------------
+  a = 112;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterConcurrent<uint64_t, 8, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 113;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterConcurrent<uint64_t, 12, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 114;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterConcurrent<uint64_t, 16, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  // adds and lookups from several threads at the same time
+  for (a = 131; a <= 132; a++) {
+    if (algorithmId == a || (algos.find(a) != algos.end())) {
+      const size_t writePercent = a == 131 ? 10 : 50;
+      double ops = MixedThreaded<
+          CuckooFilterConcurrent<uint64_t, 12, SimpleMixSplit>>(
+          add_count, to_add, to_lookup, writePercent);
+      cout << setw(NAME_WIDTH) << names[a] << flush;
+      printf("  threads: %zu, %7.2f million operations/s\n",
+        max(lookup_threads, (size_t) 2), ops);
+    }
+  }
+
+  // Cuckoo Filter that grows with the number of keys ----------------------
+  a = 115;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterDynamic<uint64_t, 12, SingleTable, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 116;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterDynamic<uint64_t, 16, SingleTable, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Cuckoo Filter with batched lookups ----------------------------------
+  a = 117;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilterStable<uint64_t, 12, SingleTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 118;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilterStable<uint64_t, 16, SingleTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 119;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilterStable<uint64_t, 13, PackedTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 120;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilter<uint64_t, 12, SingleTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 121;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilter<uint64_t, 16, SingleTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 122;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilter<uint64_t, 13, PackedTable, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Cuckoo Filter with 8 and 16 tags per bucket --------------------------
+  a = 123;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterStable<uint64_t, 16, SingleTable8Way, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 124;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterStable<uint64_t, 16, SingleTable16Way, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 125;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilterStable<uint64_t, 16, SingleTable8Way, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, false, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Static Cuckoo Filter, built by matching ------------------------------
+  a = 126;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterStatic<uint64_t, 12, SingleTable, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 127;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterStatic<uint64_t, 13, PackedTable, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 128;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          CuckooFilterStatic<uint64_t, 16, SingleTable8Way, SimpleMixSplit>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+  a = 129;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          Batched<CuckooFilterStatic<uint64_t, 16, SingleTable8Way, SimpleMixSplit>>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
+  // Xor retrieval map, used as a filter ----------------------------------
+  a = 130;
+  if (algorithmId == a || (algos.find(a) != algos.end())) {
+      auto cf = FilterBenchmark<
+          XorRetrieval<uint64_t, 8>>(
+          add_count, to_add, distinct_add, to_lookup, distinct_lookup, intersectionsize, hasduplicates, mixed_sets, seed, true);
+      cout << setw(NAME_WIDTH) << names[a] << cf << endl;
+  }
+
   // Sort ----------------------------------------------------------
   a = 100;
   if (algorithmId == a || algorithmId < 0 || (algos.find(a) != algos.end())) {
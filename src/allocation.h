@@ -0,0 +1,292 @@
+#ifndef ALLOCATION_H_
+#define ALLOCATION_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Allocation of the main table of a filter, optionally backed by huge pages.
+//
+// With large tables, almost every random access also misses the TLB; using
+// 2 MB or 1 GB pages makes the page table entries of the whole table fit in
+// the TLB. Filters allocate their table with the default policy, which
+// can be changed with setDefaultPolicy.
+//
+// On NUMA systems, tables can also be interleaved over all nodes (see
+// setDefaultInterleave), or moved to one node (see bindToNode, and
+// replicated.h to keep one copy of a filter per node).
+namespace allocation {
+
+enum Policy {
+  // plain heap memory
+  Heap = 0,
+  // anonymous memory aligned to 2 MB, with madvise(MADV_HUGEPAGE)
+  TransparentHugePages = 1,
+  // explicit huge pages (hugetlbfs), which must be reserved beforehand,
+  // for example with /proc/sys/vm/nr_hugepages
+  HugeTLB2MB = 2,
+  HugeTLB1GB = 3,
+};
+
+const size_t hugePageSize = 2 * 1024 * 1024;
+const size_t gigaPageSize = 1024 * 1024 * 1024;
+
+inline Policy &defaultPolicyRef() {
+  static Policy policy = Heap;
+  return policy;
+}
+
+inline Policy defaultPolicy() { return defaultPolicyRef(); }
+
+inline void setDefaultPolicy(Policy policy) { defaultPolicyRef() = policy; }
+
+// parse "heap", "thp", "2mb" or "1gb"; returns false if unknown
+inline bool parsePolicy(const char *name, Policy *policy) {
+  if (strcmp(name, "heap") == 0) {
+    *policy = Heap;
+  } else if (strcmp(name, "thp") == 0) {
+    *policy = TransparentHugePages;
+  } else if (strcmp(name, "2mb") == 0) {
+    *policy = HugeTLB2MB;
+  } else if (strcmp(name, "1gb") == 0) {
+    *policy = HugeTLB1GB;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A zero-initialized memory block. policy is the policy that was actually
+// used: if huge pages are not available, allocate falls back to
+// transparent huge pages, and then to the heap.
+struct Block {
+  void *data;
+  size_t bytes;
+  Policy policy;
+};
+
+inline size_t roundUp(size_t x, size_t to) { return (x + to - 1) / to * to; }
+
+#ifdef __linux__
+inline void *mapHugeTLB(size_t bytes, int sizeFlag) {
+#ifdef MAP_HUGETLB
+  void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | sizeFlag, -1, 0);
+  return p == MAP_FAILED ? nullptr : p;
+#else
+  return nullptr;
+#endif
+}
+
+// map bytes (a multiple of hugePageSize) at an address aligned to
+// hugePageSize, so that the kernel can back it with huge pages
+inline void *mapAligned(size_t bytes) {
+  size_t len = bytes + hugePageSize;
+  void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t start = (uintptr_t)p;
+  uintptr_t aligned = roundUp(start, hugePageSize);
+  if (aligned > start) {
+    munmap(p, aligned - start);
+  }
+  size_t tail = (start + len) - (aligned + bytes);
+  if (tail > 0) {
+    munmap((void *)(aligned + bytes), tail);
+  }
+  return (void *)aligned;
+}
+#endif
+
+// NUMA ----------------------------------------------------------------------
+
+// the NUMA nodes that are online, as a bit mask (at most 64 nodes)
+inline uint64_t numaNodeMask() {
+  static uint64_t mask = 0;
+  if (mask != 0) {
+    return mask;
+  }
+  uint64_t result = 0;
+  FILE *f = fopen("/sys/devices/system/node/online", "r");
+  if (f != nullptr) {
+    // a list of ranges, for example "0-1" or "0,2-3"
+    int first, last;
+    while (fscanf(f, "%d", &first) == 1) {
+      last = first;
+      int c = fgetc(f);
+      if (c == '-') {
+        if (fscanf(f, "%d", &last) != 1) {
+          break;
+        }
+        c = fgetc(f);
+      }
+      for (int i = first; i <= last && i < 64; i++) {
+        result |= UINT64_C(1) << i;
+      }
+      if (c != ',') {
+        break;
+      }
+    }
+    fclose(f);
+  }
+  mask = result == 0 ? 1 : result;
+  return mask;
+}
+
+// the number of node ids (the highest node id plus one)
+inline int numaNodeCount() {
+  return 64 - __builtin_clzll(numaNodeMask());
+}
+
+// the node of the CPU the calling thread runs on. It is read once per
+// thread, so threads should be pinned to a node.
+inline int currentNode() {
+  static __thread int node = -1;
+  if (node < 0) {
+    unsigned cpu = 0, n = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+    if (syscall(SYS_getcpu, &cpu, &n, nullptr) != 0) {
+      n = 0;
+    }
+#endif
+    node = (int)n;
+  }
+  return node;
+}
+
+// Set the NUMA policy of the pages of the block, and move the pages that
+// are already allocated. Only whole pages inside the block are affected.
+// Returns false if this is not supported.
+inline bool setNumaPolicy(const Block &block, int mode, uint64_t nodes) {
+#if defined(__linux__) && defined(SYS_mbind)
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = roundUp((uintptr_t)block.data, page);
+  uintptr_t end = ((uintptr_t)block.data + block.bytes) / page * page;
+  if (end <= start) {
+    return true;
+  }
+  unsigned long mask = (unsigned long)nodes;
+  return syscall(SYS_mbind, (void *)start, end - start, mode, &mask,
+                 sizeof(mask) * 8 + 1, MPOL_MF_MOVE) == 0;
+#else
+  return false;
+#endif
+}
+
+// move the block to the given node
+inline bool bindToNode(const Block &block, int node) {
+#ifdef __linux__
+  return setNumaPolicy(block, MPOL_BIND, UINT64_C(1) << node);
+#else
+  return false;
+#endif
+}
+
+// spread the pages of the block over all nodes
+inline bool interleave(const Block &block) {
+#ifdef __linux__
+  return setNumaPolicy(block, MPOL_INTERLEAVE, numaNodeMask());
+#else
+  return false;
+#endif
+}
+
+// the node of the page that contains the address (see move_pages(2)), or
+// -1 if unknown
+inline int nodeOf(const void *address) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  void *pages[1] = {(void *)address};
+  int status[1] = {-1};
+  if (syscall(SYS_move_pages, 0, 1UL, pages, nullptr, status, 0) != 0) {
+    return -1;
+  }
+  return status[0];
+#else
+  return -1;
+#endif
+}
+
+inline bool &defaultInterleaveRef() {
+  static bool value = false;
+  return value;
+}
+
+inline bool defaultInterleave() { return defaultInterleaveRef(); }
+
+// if true, tables are interleaved over all nodes when they are allocated
+inline void setDefaultInterleave(bool value) { defaultInterleaveRef() = value; }
+
+// Allocate bytes of zeroed memory, aligned to at least 64 bytes. Tables
+// smaller than half a huge page use the heap. Throws std::bad_alloc.
+inline Block allocate(size_t bytes, Policy policy = defaultPolicy()) {
+  Block block;
+  block.data = nullptr;
+#ifdef __linux__
+#ifdef MAP_HUGE_SHIFT
+  if (policy == HugeTLB1GB && bytes >= gigaPageSize / 2) {
+    block.bytes = roundUp(bytes, gigaPageSize);
+    block.data = mapHugeTLB(block.bytes, 30 << MAP_HUGE_SHIFT);
+    block.policy = HugeTLB1GB;
+  }
+  if (block.data == nullptr && policy >= HugeTLB2MB &&
+      bytes >= hugePageSize / 2) {
+    block.bytes = roundUp(bytes, hugePageSize);
+    block.data = mapHugeTLB(block.bytes, 21 << MAP_HUGE_SHIFT);
+    block.policy = HugeTLB2MB;
+  }
+#endif
+  if (block.data == nullptr && policy != Heap && bytes >= hugePageSize / 2) {
+    block.bytes = roundUp(bytes, hugePageSize);
+    block.data = mapAligned(block.bytes);
+    block.policy = TransparentHugePages;
+    if (block.data != nullptr) {
+#ifdef MADV_HUGEPAGE
+      madvise(block.data, block.bytes, MADV_HUGEPAGE);
+#endif
+    }
+  }
+#endif
+  if (block.data == nullptr) {
+    block.bytes = bytes;
+    block.policy = Heap;
+    if (posix_memalign(&block.data, 64, bytes == 0 ? 64 : bytes) != 0) {
+      throw ::std::bad_alloc();
+    }
+    memset(block.data, 0, bytes);
+  }
+  if (defaultInterleave()) {
+    interleave(block);
+  }
+  return block;
+}
+
+inline void deallocate(Block &block) {
+  if (block.data == nullptr) {
+    return;
+  }
+#ifdef __linux__
+  if (block.policy != Heap) {
+    munmap(block.data, block.bytes);
+    block.data = nullptr;
+    return;
+  }
+#endif
+  free(block.data);
+  block.data = nullptr;
+}
+
+}  // namespace allocation
+
+#endif  // ALLOCATION_H_
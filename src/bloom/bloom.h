@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <sstream>
 
+#include "allocation.h"
 #include "hashutil.h"
 
 using namespace std;
@@ -98,6 +99,7 @@ class BloomFilter {
 public:
 
   uint64_t *data;
+  allocation::Block memory;
   size_t size;
   size_t arrayLength;
   size_t bitCount;
@@ -106,16 +108,16 @@ public:
 
   double BitsPerItem() const { return k; }
 
-  explicit BloomFilter(const size_t n) : hasher() {
+  explicit BloomFilter(const size_t n, uint64_t seed = randomSeed()) : hasher(seed) {
     this->size = 0;
     this->kk = getBestK(bits_per_item);
     this->bitCount = n * bits_per_item;
     this->arrayLength = (bitCount + 63) / 64;
-    data = new uint64_t[arrayLength];
-    std::fill_n(data, arrayLength, 0);
+    memory = allocation::allocate(arrayLength * sizeof(uint64_t));
+    data = (uint64_t *)memory.data;
   }
 
-  ~BloomFilter() { delete[] data; }
+  ~BloomFilter() { allocation::deallocate(memory); }
 
   // Add an item to the filter.
   Status Add(const ItemType &item);
@@ -274,10 +276,11 @@ class SimpleBlockFilter {
 private:
   const size_t arrayLength;
   uint64_t* data;
+  allocation::Block memory;
   HashFamily hasher_;
 public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimpleBlockFilter(const int bits);
+  explicit SimpleBlockFilter(const int bits, uint64_t seed = randomSeed());
   ~SimpleBlockFilter() noexcept;
   void Add(const uint64_t key) noexcept;
   bool Find(const uint64_t key) const noexcept;
@@ -288,15 +291,16 @@ public:
 
 template <size_t blocksize, int k, typename HashFamily>
 SimpleBlockFilter<blocksize, k, HashFamily>::SimpleBlockFilter(
-    const int capacity)
+    const int capacity, uint64_t seed)
     : arrayLength((capacity * 10) / 64 + 8),
-      hasher_() {
-  data = new uint64_t[arrayLength]();
+      hasher_(seed) {
+  memory = allocation::allocate(arrayLength * sizeof(uint64_t));
+  data = (uint64_t*) memory.data;
 }
 
 template <size_t blocksize, int k, typename HashFamily>
 SimpleBlockFilter<blocksize, k, HashFamily>::~SimpleBlockFilter() noexcept {
-  free(data);
+  allocation::deallocate(memory);
   data = nullptr;
 }
 
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <assert.h>
 
+#include "allocation.h"
 #include "hashutil.h"
 
 #if defined(__BMI2__)
@@ -206,6 +207,7 @@ template <typename ItemType, size_t bits_per_item, bool branchless,
 class CountingBloomFilter {
 
   uint64_t *data;
+  allocation::Block memory;
   size_t arrayLength;
   HashFamily hasher;
   const int blockShift = 14;
@@ -214,12 +216,13 @@ class CountingBloomFilter {
   void AddBlock(uint32_t *tmp, int block, int len);
 
 public:
-  explicit CountingBloomFilter(const size_t n) : hasher() {
+  explicit CountingBloomFilter(const size_t n, uint64_t seed = randomSeed()) : hasher(seed) {
     size_t bitCount = 4 * n * bits_per_item;
     this->arrayLength = (bitCount + 63) / 64;
-    data = new uint64_t[arrayLength]();
+    memory = allocation::allocate(arrayLength * sizeof(uint64_t));
+    data = (uint64_t *)memory.data;
   }
-  ~CountingBloomFilter() { delete[] data; }
+  ~CountingBloomFilter() { allocation::deallocate(memory); }
   Status Add(const ItemType &item);
   Status AddAll(const vector<ItemType> data, const size_t start, const size_t end);
   Status Remove(const ItemType &item);
@@ -330,6 +333,9 @@ class SuccinctCountingBloomFilter {
   uint64_t *data;
   uint64_t *counts;
   uint64_t *overflow;
+  allocation::Block dataMemory;
+  allocation::Block countsMemory;
+  allocation::Block overflowMemory;
 #ifdef VERIFY_COUNT
   uint8_t *realCount;
 #endif
@@ -346,13 +352,17 @@ class SuccinctCountingBloomFilter {
   void AddBlock(uint32_t *tmp, int block, int len);
 
 public:
-  explicit SuccinctCountingBloomFilter(const size_t n) : hasher() {
+  explicit SuccinctCountingBloomFilter(const size_t n,
+      uint64_t seed = randomSeed()) : hasher(seed) {
     size_t bitCount = n * bits_per_item;
     this->arrayLength = (bitCount + 63) / 64;
     this->overflowLength = 100 + arrayLength / 100 * 12;
-    data = new uint64_t[arrayLength]();
-    counts = new uint64_t[arrayLength]();
-    overflow = new uint64_t[overflowLength]();
+    dataMemory = allocation::allocate(arrayLength * sizeof(uint64_t));
+    data = (uint64_t *)dataMemory.data;
+    countsMemory = allocation::allocate(arrayLength * sizeof(uint64_t));
+    counts = (uint64_t *)countsMemory.data;
+    overflowMemory = allocation::allocate(overflowLength * sizeof(uint64_t));
+    overflow = (uint64_t *)overflowMemory.data;
 #ifdef VERIFY_COUNT
     realCount = new uint8_t[arrayLength * 64]();
 #endif
@@ -361,7 +371,11 @@ public:
         overflow[i] = i + 4;
     }
   }
-  ~SuccinctCountingBloomFilter() { delete[] data; delete[] counts; delete[] overflow; }
+  ~SuccinctCountingBloomFilter() {
+    allocation::deallocate(dataMemory);
+    allocation::deallocate(countsMemory);
+    allocation::deallocate(overflowMemory);
+  }
   Status Add(const ItemType &item);
   Status AddAll(const vector<ItemType> data, const size_t start, const size_t end);
   Status Remove(const ItemType &item);
@@ -615,6 +629,9 @@ private:
   uint64_t *data;
   uint64_t *counts;
   uint64_t *overflow;
+  allocation::Block dataMemory;
+  allocation::Block countsMemory;
+  allocation::Block overflowMemory;
   size_t overflowLength;
   size_t nextFreeOverflow;
 #ifdef VERIFY_COUNT
@@ -629,7 +646,7 @@ private:
 #endif
 
 public:
-  explicit SuccinctCountingBlockedBloomFilter(const int capacity);
+  explicit SuccinctCountingBlockedBloomFilter(const int capacity, uint64_t seed = randomSeed());
   ~SuccinctCountingBlockedBloomFilter() noexcept;
   void Add(const uint64_t key) noexcept;
   void Remove(const uint64_t key) noexcept;
@@ -641,18 +658,17 @@ public:
 
 template <typename ItemType, size_t bits_per_item, typename HashFamily, int k>
 SuccinctCountingBlockedBloomFilter<ItemType, bits_per_item, HashFamily, k>::
-    SuccinctCountingBlockedBloomFilter(const int capacity)
-    : bucketCount(capacity * bits_per_item / 512), hasher() {
+    SuccinctCountingBlockedBloomFilter(const int capacity, uint64_t seed)
+    : bucketCount(capacity * bits_per_item / 512), hasher(seed) {
   const size_t alloc_size = bucketCount * (512 / 8);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void **>(&data), 64, alloc_size);
-  if (malloc_failed)
-    throw ::std::bad_alloc();
-  memset(data, 0, alloc_size);
+  dataMemory = allocation::allocate(alloc_size);
+  data = (uint64_t *)dataMemory.data;
   size_t arrayLength = bucketCount * 8;
   overflowLength = 100 + arrayLength / 100 * 36;
-  counts = new uint64_t[arrayLength]();
-  overflow = new uint64_t[overflowLength]();
+  countsMemory = allocation::allocate(arrayLength * sizeof(uint64_t));
+  counts = (uint64_t *)countsMemory.data;
+  overflowMemory = allocation::allocate(overflowLength * sizeof(uint64_t));
+  overflow = (uint64_t *)overflowMemory.data;
 #ifdef VERIFY_COUNT
   realCount = new uint8_t[arrayLength * 64]();
 #endif
@@ -665,9 +681,9 @@ SuccinctCountingBlockedBloomFilter<ItemType, bits_per_item, HashFamily, k>::
 template <typename ItemType, size_t bits_per_item, typename HashFamily, int k>
 SuccinctCountingBlockedBloomFilter<ItemType, bits_per_item, HashFamily, k>::
     ~SuccinctCountingBlockedBloomFilter() noexcept {
-  free(data);
-  delete[] counts;
-  delete[] overflow;
+  allocation::deallocate(dataMemory);
+  allocation::deallocate(countsMemory);
+  allocation::deallocate(overflowMemory);
 }
 
 static inline uint64_t rotl64(uint64_t n, unsigned int c) {
@@ -903,6 +919,9 @@ private:
   uint64_t *data;
   uint64_t *counts;
   uint64_t *overflow;
+  allocation::Block dataMemory;
+  allocation::Block countsMemory;
+  allocation::Block overflowMemory;
   size_t overflowLength;
   size_t nextFreeOverflow;
 #ifdef VERIFY_COUNT
@@ -917,7 +936,7 @@ private:
 #endif
 
 public:
-  explicit SuccinctCountingBlockedBloomRankFilter(const int capacity);
+  explicit SuccinctCountingBlockedBloomRankFilter(const int capacity, uint64_t seed = randomSeed());
   ~SuccinctCountingBlockedBloomRankFilter() noexcept;
   void Add(const uint64_t key) noexcept;
   void Remove(const uint64_t key) noexcept;
@@ -929,18 +948,17 @@ public:
 
 template <typename ItemType, size_t bits_per_item, typename HashFamily, int k>
 SuccinctCountingBlockedBloomRankFilter<ItemType, bits_per_item, HashFamily, k>::
-    SuccinctCountingBlockedBloomRankFilter(const int capacity)
-    : bucketCount(capacity * bits_per_item / 512), hasher() {
+    SuccinctCountingBlockedBloomRankFilter(const int capacity, uint64_t seed)
+    : bucketCount(capacity * bits_per_item / 512), hasher(seed) {
   const size_t alloc_size = bucketCount * (512 / 8);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void **>(&data), 64, alloc_size);
-  if (malloc_failed)
-    throw ::std::bad_alloc();
-  memset(data, 0, alloc_size);
+  dataMemory = allocation::allocate(alloc_size);
+  data = (uint64_t *)dataMemory.data;
   size_t arrayLength = bucketCount * 8;
   overflowLength = 100 + arrayLength / 100 * 36;
-  counts = new uint64_t[arrayLength]();
-  overflow = new uint64_t[overflowLength]();
+  countsMemory = allocation::allocate(arrayLength * sizeof(uint64_t));
+  counts = (uint64_t *)countsMemory.data;
+  overflowMemory = allocation::allocate(overflowLength * sizeof(uint64_t));
+  overflow = (uint64_t *)overflowMemory.data;
 #ifdef VERIFY_COUNT
   realCount = new uint8_t[arrayLength * 64]();
 #endif
@@ -953,9 +971,9 @@ SuccinctCountingBlockedBloomRankFilter<ItemType, bits_per_item, HashFamily, k>::
 template <typename ItemType, size_t bits_per_item, typename HashFamily, int k>
 SuccinctCountingBlockedBloomRankFilter<ItemType, bits_per_item, HashFamily, k>::
     ~SuccinctCountingBlockedBloomRankFilter() noexcept {
-  free(data);
-  delete[] counts;
-  delete[] overflow;
+  allocation::deallocate(dataMemory);
+  allocation::deallocate(countsMemory);
+  allocation::deallocate(overflowMemory);
 }
 
 template <typename ItemType, size_t bits_per_item, typename HashFamily, int k>
@@ -14,11 +14,13 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 #include <algorithm>
 #include <new>
 
 
+#include "allocation.h"
 #include "hashutil.h"
 
 using uint32_t = ::std::uint32_t;
@@ -50,13 +52,28 @@ class SimdBlockFilterFixed {
   const int bucketCount;
 
   Bucket* directory_;
+  ::allocation::Block memory_;
 
   HashFamily hasher_;
 
  public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimdBlockFilterFixed(const int bits);
+  explicit SimdBlockFilterFixed(const int bits, uint64_t seed = ::hashing::randomSeed());
   ~SimdBlockFilterFixed() noexcept;
+  // Copy the filter, including its table.
+  SimdBlockFilterFixed(const SimdBlockFilterFixed &o)
+    : bucketCount(o.bucketCount), directory_(nullptr), hasher_(o.hasher_) {
+    memory_ = ::allocation::allocate(bucketCount * sizeof(Bucket));
+    directory_ = reinterpret_cast<Bucket*>(memory_.data);
+    memcpy(directory_, o.directory_, bucketCount * sizeof(Bucket));
+  }
+  // Take over the table of another filter, which is left without one.
+  SimdBlockFilterFixed(SimdBlockFilterFixed &&o)
+    : bucketCount(o.bucketCount), directory_(o.directory_), memory_(o.memory_),
+      hasher_(o.hasher_) {
+    o.directory_ = nullptr;
+    o.memory_.data = nullptr;
+  }
   void Add(const uint64_t key) noexcept;
 
   // Add multiple items to the filter.
@@ -67,6 +84,8 @@ class SimdBlockFilterFixed {
 
   bool Find(const uint64_t key) const noexcept;
   uint64_t SizeInBytes() const { return sizeof(Bucket) * bucketCount; }
+  // the memory of the table
+  const ::allocation::Block &Memory() const { return memory_; }
 
  private:
   // A helper function for Insert()/Find(). Turns a 32-bit hash into a 256-bit Bucket
@@ -78,7 +97,7 @@ class SimdBlockFilterFixed {
 };
 
 template<typename HashFamily>
-SimdBlockFilterFixed<HashFamily>::SimdBlockFilterFixed(const int bits)
+SimdBlockFilterFixed<HashFamily>::SimdBlockFilterFixed(const int bits, uint64_t seed)
     // bits / 16: fpp 0.1777%, 75.1%
     // bits / 20: fpp 0.4384%, 63.4%
     // bits / 22: fpp 0.6692%, 61.1%
@@ -88,20 +107,18 @@ SimdBlockFilterFixed<HashFamily>::SimdBlockFilterFixed(const int bits)
     // bits / 32: fpp 3.3280%, 63.0%
   : bucketCount(::std::max(1, bits / 24)),
     directory_(nullptr),
-    hasher_() {
+    hasher_(seed) {
   if (!__builtin_cpu_supports("avx2")) {
     throw ::std::runtime_error("SimdBlockFilterFixed does not work without AVX2 instructions");
   }
   const size_t alloc_size = bucketCount * sizeof(Bucket);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void**>(&directory_), 64, alloc_size);
-  if (malloc_failed) throw ::std::bad_alloc();
-  memset(directory_, 0, alloc_size);
+  memory_ = ::allocation::allocate(alloc_size);
+  directory_ = reinterpret_cast<Bucket*>(memory_.data);
 }
 
 template<typename HashFamily>
 SimdBlockFilterFixed<HashFamily>::~SimdBlockFilterFixed() noexcept {
-  free(directory_);
+  ::allocation::deallocate(memory_);
   directory_ = nullptr;
 }
 
@@ -210,17 +227,34 @@ class SimdBlockFilterFixed64 {
   const int bucketCount;
 
   Bucket* directory_;
+  ::allocation::Block memory_;
 
   HashFamily hasher_;
 
  public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimdBlockFilterFixed64(const int bits);
+  explicit SimdBlockFilterFixed64(const int bits, uint64_t seed = ::hashing::randomSeed());
   ~SimdBlockFilterFixed64() noexcept;
+  // Copy the filter, including its table.
+  SimdBlockFilterFixed64(const SimdBlockFilterFixed64 &o)
+    : bucketCount(o.bucketCount), directory_(nullptr), hasher_(o.hasher_) {
+    memory_ = ::allocation::allocate(bucketCount * sizeof(Bucket));
+    directory_ = reinterpret_cast<Bucket*>(memory_.data);
+    memcpy(directory_, o.directory_, bucketCount * sizeof(Bucket));
+  }
+  // Take over the table of another filter, which is left without one.
+  SimdBlockFilterFixed64(SimdBlockFilterFixed64 &&o)
+    : bucketCount(o.bucketCount), directory_(o.directory_), memory_(o.memory_),
+      hasher_(o.hasher_) {
+    o.directory_ = nullptr;
+    o.memory_.data = nullptr;
+  }
   void Add(const uint64_t key) noexcept;
 
   bool Find(const uint64_t key) const noexcept;
   uint64_t SizeInBytes() const { return sizeof(Bucket) * bucketCount; }
+  // the memory of the table
+  const ::allocation::Block &Memory() const { return memory_; }
 
  private:
   static mask64bytes_t MakeMask(const uint64_t hash) noexcept;
@@ -229,24 +263,22 @@ class SimdBlockFilterFixed64 {
 };
 
 template<typename HashFamily>
-SimdBlockFilterFixed64<HashFamily>::SimdBlockFilterFixed64(const int bits)
+SimdBlockFilterFixed64<HashFamily>::SimdBlockFilterFixed64(const int bits, uint64_t seed)
 
   : bucketCount(::std::max(1, bits / 50)),
     directory_(nullptr),
-    hasher_() {
+    hasher_(seed) {
   if (!__builtin_cpu_supports("avx2")) {
     throw ::std::runtime_error("SimdBlockFilterFixed64 does not work without AVX2 instructions");
   }
   const size_t alloc_size = bucketCount * sizeof(Bucket);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void**>(&directory_), 64, alloc_size);
-  if (malloc_failed) throw ::std::bad_alloc();
-  memset(directory_, 0, alloc_size);
+  memory_ = ::allocation::allocate(alloc_size);
+  directory_ = reinterpret_cast<Bucket*>(memory_.data);
 }
 
 template<typename HashFamily>
 SimdBlockFilterFixed64<HashFamily>::~SimdBlockFilterFixed64() noexcept {
-  free(directory_);
+  ::allocation::deallocate(memory_);
   directory_ = nullptr;
 }
 
@@ -307,13 +339,28 @@ class SimdBlockFilterFixed {
   const int bucketCount;
 
   Bucket* directory_;
+  ::allocation::Block memory_;
 
   HashFamily hasher_;
 
  public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimdBlockFilterFixed(const int bits);
+  explicit SimdBlockFilterFixed(const int bits, uint64_t seed = ::hashing::randomSeed());
   ~SimdBlockFilterFixed() noexcept;
+  // Copy the filter, including its table.
+  SimdBlockFilterFixed(const SimdBlockFilterFixed &o)
+    : bucketCount(o.bucketCount), directory_(nullptr), hasher_(o.hasher_) {
+    memory_ = ::allocation::allocate(bucketCount * sizeof(Bucket));
+    directory_ = reinterpret_cast<Bucket*>(memory_.data);
+    memcpy(directory_, o.directory_, bucketCount * sizeof(Bucket));
+  }
+  // Take over the table of another filter, which is left without one.
+  SimdBlockFilterFixed(SimdBlockFilterFixed &&o)
+    : bucketCount(o.bucketCount), directory_(o.directory_), memory_(o.memory_),
+      hasher_(o.hasher_) {
+    o.directory_ = nullptr;
+    o.memory_.data = nullptr;
+  }
   void Add(const uint64_t key) noexcept;
 
   // Add multiple items to the filter.
@@ -325,6 +372,8 @@ class SimdBlockFilterFixed {
 
   bool Find(const uint64_t key) const noexcept;
   uint64_t SizeInBytes() const { return sizeof(Bucket) * bucketCount; }
+  // the memory of the table
+  const ::allocation::Block &Memory() const { return memory_; }
 
  private:
   // A helper function for Insert()/Find(). Turns a 32-bit hash into a 256-bit Bucket
@@ -336,20 +385,18 @@ class SimdBlockFilterFixed {
 };
 
 template<typename HashFamily>
-SimdBlockFilterFixed<HashFamily>::SimdBlockFilterFixed(const int bits)
+SimdBlockFilterFixed<HashFamily>::SimdBlockFilterFixed(const int bits, uint64_t seed)
   : bucketCount(::std::max(1, bits / 10)),
     directory_(nullptr),
-    hasher_() {
+    hasher_(seed) {
   const size_t alloc_size = bucketCount * sizeof(Bucket);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void**>(&directory_), 64, alloc_size);
-  if (malloc_failed) throw ::std::bad_alloc();
-  memset(directory_, 0, alloc_size);
+  memory_ = ::allocation::allocate(alloc_size);
+  directory_ = reinterpret_cast<Bucket*>(memory_.data);
 }
 
 template<typename HashFamily>
 SimdBlockFilterFixed<HashFamily>::~SimdBlockFilterFixed() noexcept {
-  free(directory_);
+  ::allocation::deallocate(memory_);
   directory_ = nullptr;
 }
 
@@ -411,17 +458,34 @@ class SimdBlockFilterFixed16 {
   const int bucketCount;
 
   Bucket* directory_;
+  ::allocation::Block memory_;
 
   HashFamily hasher_;
 
  public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimdBlockFilterFixed16(const int bits);
+  explicit SimdBlockFilterFixed16(const int bits, uint64_t seed = ::hashing::randomSeed());
   ~SimdBlockFilterFixed16() noexcept;
+  // Copy the filter, including its table.
+  SimdBlockFilterFixed16(const SimdBlockFilterFixed16 &o)
+    : bucketCount(o.bucketCount), directory_(nullptr), hasher_(o.hasher_) {
+    memory_ = ::allocation::allocate(bucketCount * sizeof(Bucket));
+    directory_ = reinterpret_cast<Bucket*>(memory_.data);
+    memcpy(directory_, o.directory_, bucketCount * sizeof(Bucket));
+  }
+  // Take over the table of another filter, which is left without one.
+  SimdBlockFilterFixed16(SimdBlockFilterFixed16 &&o)
+    : bucketCount(o.bucketCount), directory_(o.directory_), memory_(o.memory_),
+      hasher_(o.hasher_) {
+    o.directory_ = nullptr;
+    o.memory_.data = nullptr;
+  }
   void Add(const uint64_t key) noexcept;
 
   bool Find(const uint64_t key) const noexcept;
   uint64_t SizeInBytes() const { return sizeof(Bucket) * bucketCount; }
+  // the memory of the table
+  const ::allocation::Block &Memory() const { return memory_; }
 
  private:
   static __m128i MakeMask(const uint64_t hash) noexcept;
@@ -430,21 +494,19 @@ class SimdBlockFilterFixed16 {
 };
 
 template<typename HashFamily>
-SimdBlockFilterFixed16<HashFamily>::SimdBlockFilterFixed16(const int bits)
+SimdBlockFilterFixed16<HashFamily>::SimdBlockFilterFixed16(const int bits, uint64_t seed)
 
   : bucketCount(::std::max(1, bits / 10)),
     directory_(nullptr),
-    hasher_() {
+    hasher_(seed) {
   const size_t alloc_size = bucketCount * sizeof(Bucket);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void**>(&directory_), 64, alloc_size);
-  if (malloc_failed) throw ::std::bad_alloc();
-  memset(directory_, 0, alloc_size);
+  memory_ = ::allocation::allocate(alloc_size);
+  directory_ = reinterpret_cast<Bucket*>(memory_.data);
 }
 
 template<typename HashFamily>
 SimdBlockFilterFixed16<HashFamily>::~SimdBlockFilterFixed16() noexcept {
-  free(directory_);
+  ::allocation::deallocate(memory_);
   directory_ = nullptr;
 }
 
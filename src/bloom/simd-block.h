@@ -20,6 +20,7 @@
 
 #include <immintrin.h>
 
+#include "allocation.h"
 #include "hashutil.h"
 
 using uint32_t = ::std::uint32_t;
@@ -46,17 +47,22 @@ class SimdBlockFilter {
   const uint32_t directory_mask_;
 
   Bucket* directory_;
+  ::allocation::Block memory_;
 
   HashFamily hasher_;
 
  public:
   // Consumes at most (1 << log_heap_space) bytes on the heap:
-  explicit SimdBlockFilter(const int log_heap_space);
+  explicit SimdBlockFilter(const int log_heap_space, uint64_t seed = ::hashing::randomSeed());
   SimdBlockFilter(SimdBlockFilter&& that)
     : log_num_buckets_(that.log_num_buckets_),
       directory_mask_(that.directory_mask_),
       directory_(that.directory_),
-      hasher_(that.hasher_) {}
+      memory_(that.memory_),
+      hasher_(that.hasher_) {
+    that.directory_ = nullptr;
+    that.memory_.data = nullptr;
+  }
   ~SimdBlockFilter() noexcept;
   void Add(const uint64_t key) noexcept;
   bool Find(const uint64_t key) const noexcept;
@@ -72,7 +78,7 @@ class SimdBlockFilter {
 };
 
 template<typename HashFamily>
-SimdBlockFilter<HashFamily>::SimdBlockFilter(const int log_heap_space)
+SimdBlockFilter<HashFamily>::SimdBlockFilter(const int log_heap_space, uint64_t seed)
   :  // Since log_heap_space is in bytes, we need to convert it to the number of Buckets
      // we will use.
     log_num_buckets_(::std::max(1, log_heap_space - LOG_BUCKET_BYTE_SIZE)),
@@ -80,20 +86,18 @@ SimdBlockFilter<HashFamily>::SimdBlockFilter(const int log_heap_space)
     // too large.
     directory_mask_((1ull << ::std::min(63, log_num_buckets_)) - 1),
     directory_(nullptr),
-    hasher_() {
+    hasher_(seed) {
   if (!__builtin_cpu_supports("avx2")) {
     throw ::std::runtime_error("SimdBlockFilter does not work without AVX2 instructions");
   }
   const size_t alloc_size = 1ull << (log_num_buckets_ + LOG_BUCKET_BYTE_SIZE);
-  const int malloc_failed =
-      posix_memalign(reinterpret_cast<void**>(&directory_), 64, alloc_size);
-  if (malloc_failed) throw ::std::bad_alloc();
-  memset(directory_, 0, alloc_size);
+  memory_ = ::allocation::allocate(alloc_size);
+  directory_ = reinterpret_cast<Bucket*>(memory_.data);
 }
 
 template<typename HashFamily>
 SimdBlockFilter<HashFamily>::~SimdBlockFilter() noexcept {
-  free(directory_);
+  ::allocation::deallocate(memory_);
   directory_ = nullptr;
 }
 
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <algorithm>
 
+#include "cuckoopath.h"
 #include "debug.h"
 #include "hashutil.h"
 #include "packedtable.h"
@@ -22,6 +23,15 @@ enum Status {
 // maximum number of cuckoo kicks before claiming failure
 const size_t kMaxCuckooCount = 500;
 
+// number of keys whose buckets ContainBatch prefetches before reading any
+const size_t kContainBatchSize = 32;
+
+// the load factor tables are sized for, by number of tags per bucket:
+// above it, cuckoo paths get long, and inserts start to fail
+inline double MaxLoadFactor(size_t tags_per_bucket) {
+  return tags_per_bucket <= 2 ? 0.84 : (tags_per_bucket == 4 ? 0.94 : 0.98);
+}
+
 // A cuckoo filter class exposes a Bloomier filter interface,
 // providing methods of Add, Delete, Contain. It takes three
 // template parameters:
@@ -39,16 +49,11 @@ class CuckooFilter {
   // Number of items stored
   size_t num_items_;
 
-  typedef struct {
-    size_t index;
-    uint32_t tag;
-    bool used;
-  } VictimCache;
-
-  VictimCache victim_;
-
   HashFamily hasher_;
 
+  // scratch memory of the cuckoo path search
+  std::vector<BfsNode> bfs_queue_;
+
   inline size_t IndexHash(uint32_t hv) const {
     // table_->num_buckets is always a power of two, so modulo can be replaced
     // with
@@ -78,7 +83,7 @@ class CuckooFilter {
     return IndexHash((uint32_t)(index ^ (tag * 0x5bd1e995)));
   }
 
-  Status AddImpl(const size_t i, const uint32_t tag);
+  Status AddImpl(const size_t i1, const size_t i2, const uint32_t tag);
 
   // load factor is the fraction of occupancy
   double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
@@ -86,25 +91,34 @@ class CuckooFilter {
   double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
 
  public:
-  explicit CuckooFilter(const size_t max_num_keys) : num_items_(0), victim_(), hasher_() {
-    size_t assoc = 4;
+  static const size_t kTagsPerBucket = TableType<bits_per_item>::kTagsPerBucket;
+
+  explicit CuckooFilter(const size_t max_num_keys, uint64_t seed = ::hashing::randomSeed())
+      : num_items_(0), hasher_(seed) {
+    size_t assoc = kTagsPerBucket;
     size_t num_buckets = upperpower2(std::max<uint64_t>(1, max_num_keys / assoc));
     double frac = (double)max_num_keys / num_buckets / assoc;
-    if (frac > 0.94) {
+    if (frac > MaxLoadFactor(assoc)) {
       num_buckets <<= 1;
     }
-    victim_.used = false;
     table_ = new TableType<bits_per_item>(num_buckets);
   }
 
   ~CuckooFilter() { delete table_; }
 
-  // Add an item to the filter.
+  // Add an item to the filter. Returns NotEnoughSpace if no cuckoo path
+  // was found; the filter is then unchanged.
   Status Add(const ItemType &item);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Report for n keys if they are inserted: out[i] is 1 if keys[i] may be
+  // in the filter, 0 otherwise. Keys are processed in groups; both buckets
+  // of all keys of a group are prefetched before they are read, so that
+  // the cache misses overlap.
+  void ContainBatch(const ItemType *keys, size_t n, uint8_t *out) const;
+
   // Delete an key from the filter
   Status Delete(const ItemType &item);
 
@@ -117,55 +131,45 @@ class CuckooFilter {
 
   // size of the filter in bytes.
   size_t SizeInBytes() const { return table_->SizeInBytes(); }
+
+  // number of slots of the table.
+  size_t SizeInTags() const { return table_->SizeInTags(); }
 };
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Add(
     const ItemType &item) {
-  size_t i;
+  size_t i1, i2;
   uint32_t tag;
 
-  if (victim_.used) {
-    return NotEnoughSpace;
-  }
-
-  GenerateIndexTagHash(item, &i, &tag);
-  return AddImpl(i, tag);
+  GenerateIndexTagHash(item, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+  return AddImpl(i1, i2, tag);
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::AddImpl(
-    const size_t i, const uint32_t tag) {
-  size_t curindex = i;
-  uint32_t curtag = tag;
-  uint32_t oldtag;
-
-  for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
-    bool kickout = count > 0;
-    oldtag = 0;
-    if (table_->InsertTagToBucket(curindex, curtag, kickout, oldtag)) {
-      num_items_++;
-      return Ok;
-    }
-    if (kickout) {
-      curtag = oldtag;
-    }
-    curindex = AltIndex(curindex, curtag);
+    const size_t i1, const size_t i2, const uint32_t tag) {
+  uint32_t unused;
+  if (table_->InsertTagToBucket(i1, tag, false, unused) ||
+      table_->InsertTagToBucket(i2, tag, false, unused)) {
+    num_items_++;
+    return Ok;
   }
-
-  victim_.index = curindex;
-  victim_.tag = curtag;
-  victim_.used = true;
-  return Ok;
+  auto altIndex = [this](size_t index, uint32_t t) { return AltIndex(index, t); };
+  if (InsertAlongShortestPath(table_, i1, i2, tag, altIndex, bfs_queue_)) {
+    num_items_++;
+    return Ok;
+  }
+  return NotEnoughSpace;
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Contain(
     const ItemType &key) const {
-  bool found = false;
   size_t i1, i2;
   uint32_t tag;
 
@@ -174,16 +178,34 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Contain(
 
   assert(i1 == AltIndex(i2, tag));
 
-  found = victim_.used && (tag == victim_.tag) &&
-          (i1 == victim_.index || i2 == victim_.index);
-
-  if (found || table_->FindTagInBuckets(i1, i2, tag)) {
+  if (table_->FindTagInBuckets(i1, i2, tag)) {
     return Ok;
   } else {
     return NotFound;
   }
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::ContainBatch(
+    const ItemType *keys, size_t n, uint8_t *out) const {
+  size_t i1s[kContainBatchSize];
+  size_t i2s[kContainBatchSize];
+  uint32_t tags[kContainBatchSize];
+  for (size_t start = 0; start < n; start += kContainBatchSize) {
+    size_t len = std::min(kContainBatchSize, n - start);
+    for (size_t i = 0; i < len; i++) {
+      GenerateIndexTagHash(keys[start + i], &i1s[i], &tags[i]);
+      i2s[i] = AltIndex(i1s[i], tags[i]);
+      table_->PrefetchBucket(i1s[i]);
+      table_->PrefetchBucket(i2s[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+      out[start + i] = table_->FindTagInBuckets(i1s[i], i2s[i], tags[i]);
+    }
+  }
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Delete(
@@ -194,28 +216,12 @@ Status CuckooFilter<ItemType, bits_per_item, TableType, HashFamily>::Delete(
   GenerateIndexTagHash(key, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
-  if (table_->DeleteTagFromBucket(i1, tag)) {
+  if (table_->DeleteTagFromBucket(i1, tag) ||
+      table_->DeleteTagFromBucket(i2, tag)) {
     num_items_--;
-    goto TryEliminateVictim;
-  } else if (table_->DeleteTagFromBucket(i2, tag)) {
-    num_items_--;
-    goto TryEliminateVictim;
-  } else if (victim_.used && tag == victim_.tag &&
-             (i1 == victim_.index || i2 == victim_.index)) {
-    // num_items_--;
-    victim_.used = false;
     return Ok;
-  } else {
-    return NotFound;
-  }
-TryEliminateVictim:
-  if (victim_.used) {
-    victim_.used = false;
-    size_t i = victim_.index;
-    uint32_t tag = victim_.tag;
-    AddImpl(i, tag);
   }
-  return Ok;
+  return NotFound;
 }
 
 template <typename ItemType, size_t bits_per_item,
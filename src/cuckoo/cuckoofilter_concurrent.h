@@ -0,0 +1,385 @@
+#ifndef CUCKOO_FILTER_CUCKOO_FILTER_CONCURRENT_H_
+#define CUCKOO_FILTER_CUCKOO_FILTER_CONCURRENT_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "allocation.h"
+#include "cuckoofilter.h"
+#include "hashutil.h"
+#include "singletable.h"
+
+namespace cuckoofilter {
+
+// largest number of lock stripes of a concurrent cuckoo filter
+const size_t kMaxLockStripes = 1 << 12;
+
+// number of cuckoo paths searched before an insertion fails
+const int kMaxPathSearches = 16;
+
+// Wait for a writer: spin for a while, then let other threads run, in
+// case the writer is not running.
+inline void Backoff(int &spins) {
+  if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  } else {
+    std::this_thread::yield();
+  }
+}
+
+// A cuckoo filter that can be used by many threads at the same time
+// (libcuckoo style, see Li et al., "Algorithmic improvements for fast
+// concurrent cuckoo hashing", 2014).
+//
+// Buckets are protected by lock stripes, each a version counter that is
+// odd while a writer holds it. Lookups do not take locks: they read the
+// versions of the two buckets, then the buckets, and retry if a version
+// changed in between. Insertions first search a cuckoo path without
+// locks, then move the tags along the path from its end, one move at a
+// time under the locks of its two buckets, so that a key can always be
+// found in one of its buckets. A move that finds the table changed
+// restarts the search. There is no victim cache: an insertion that fails
+// leaves the keys in the filter as they were.
+template <typename ItemType, size_t bits_per_item,
+          typename HashFamily = hashing::TwoIndependentMultiplyShift>
+class CuckooFilterConcurrent {
+  // a version counter, on its own cache line
+  struct Stripe {
+    uint32_t version;
+    char padding[64 - sizeof(uint32_t)];
+  };
+
+  // a slot of a cuckoo path, and the tag it held when the path was found
+  struct PathEntry {
+    size_t bucket;
+    size_t slot;
+    uint32_t tag;
+  };
+
+  static const size_t kTagsPerBucket = 4;
+
+  // Storage of items
+  SingleTable<bits_per_item> *table_;
+
+  Stripe *stripes_;
+  ::allocation::Block stripe_memory_;
+  size_t num_stripes_;
+
+  // Number of items stored
+  size_t num_items_;
+
+  HashFamily hasher_;
+
+  inline size_t IndexHash(uint32_t hv) const {
+    // table_->num_buckets is always a power of two, so modulo can be replaced
+    // with bitwise-and:
+    return hv & (table_->NumBuckets() - 1);
+  }
+
+  inline uint32_t TagHash(uint32_t hv) const {
+    uint32_t tag;
+    tag = hv & ((1ULL << bits_per_item) - 1);
+    tag += (tag == 0);
+    return tag;
+  }
+
+  inline void GenerateIndexTagHash(const ItemType& item, size_t* index,
+                                   uint32_t* tag) const {
+    const uint64_t hash = hasher_(item);
+    *index = IndexHash(hash >> 32);
+    *tag = TagHash(hash);
+  }
+
+  inline size_t AltIndex(const size_t index, const uint32_t tag) const {
+    // 0x5bd1e995 is the hash constant from MurmurHash2
+    return IndexHash((uint32_t)(index ^ (tag * 0x5bd1e995)));
+  }
+
+  inline uint32_t *VersionOf(const size_t bucket) const {
+    return &stripes_[bucket & (num_stripes_ - 1)].version;
+  }
+
+  void Lock(uint32_t *version) {
+    int spins = 0;
+    while (true) {
+      uint32_t v = __atomic_load_n(version, __ATOMIC_RELAXED);
+      if ((v & 1) == 0 &&
+          __atomic_compare_exchange_n(version, &v, v + 1, true,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        break;
+      }
+      Backoff(spins);
+    }
+    // the writes to the table must not be seen before the version change
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+
+  void Unlock(uint32_t *version) {
+    __atomic_store_n(version, __atomic_load_n(version, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELEASE);
+  }
+
+  // Lock the stripes of two buckets, in stripe order to avoid deadlocks.
+  void LockTwo(const size_t b1, const size_t b2) {
+    uint32_t *v1 = VersionOf(b1), *v2 = VersionOf(b2);
+    if (v1 > v2) {
+      std::swap(v1, v2);
+    }
+    Lock(v1);
+    if (v2 != v1) {
+      Lock(v2);
+    }
+  }
+
+  void UnlockTwo(const size_t b1, const size_t b2) {
+    uint32_t *v1 = VersionOf(b1), *v2 = VersionOf(b2);
+    Unlock(v1);
+    if (v2 != v1) {
+      Unlock(v2);
+    }
+  }
+
+  bool FindPath(const size_t i1, const size_t i2, uint64_t &random,
+                std::vector<PathEntry> &path) const;
+
+  bool MoveAlongPath(const std::vector<PathEntry> &path);
+
+  // load factor is the fraction of occupancy
+  double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
+
+  double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
+
+ public:
+  explicit CuckooFilterConcurrent(const size_t max_num_keys,
+                                  uint64_t seed = ::hashing::randomSeed())
+      : num_items_(0), hasher_(seed) {
+    size_t assoc = kTagsPerBucket;
+    size_t num_buckets = upperpower2(std::max<uint64_t>(1, max_num_keys / assoc));
+    double frac = (double)max_num_keys / num_buckets / assoc;
+    if (frac > 0.94) {
+      num_buckets <<= 1;
+    }
+    table_ = new SingleTable<bits_per_item>(num_buckets);
+    num_stripes_ = std::min(num_buckets, kMaxLockStripes);
+    stripe_memory_ = ::allocation::allocate(num_stripes_ * sizeof(Stripe));
+    stripes_ = reinterpret_cast<Stripe *>(stripe_memory_.data);
+  }
+
+  CuckooFilterConcurrent(CuckooFilterConcurrent &&o)
+      : table_(o.table_), stripes_(o.stripes_),
+        stripe_memory_(o.stripe_memory_), num_stripes_(o.num_stripes_),
+        num_items_(o.num_items_), hasher_(o.hasher_) {
+    o.table_ = nullptr;
+    o.stripes_ = nullptr;
+    o.stripe_memory_.data = nullptr;
+  }
+
+  ~CuckooFilterConcurrent() {
+    ::allocation::deallocate(stripe_memory_);
+    delete table_;
+  }
+
+  // Add an item to the filter. Returns NotEnoughSpace if no cuckoo path
+  // was found; the filter is then unchanged.
+  Status Add(const ItemType &item);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Delete an key from the filter
+  Status Delete(const ItemType &item);
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return __atomic_load_n(&num_items_, __ATOMIC_RELAXED); }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return table_->SizeInBytes(); }
+
+ private:
+  CuckooFilterConcurrent(const CuckooFilterConcurrent &) = delete;
+  CuckooFilterConcurrent &operator=(const CuckooFilterConcurrent &) = delete;
+};
+
+inline uint64_t NextRandom(uint64_t &state) {
+  // splitmix64
+  uint64_t z = (state += UINT64_C(0x9E3779B97F4A7C15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+// Search a random walk from one of the buckets of the key to a bucket with
+// an empty slot, without locks (so the table may change meanwhile). The
+// last entry of the path is the empty slot.
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+bool CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::FindPath(
+    const size_t i1, const size_t i2, uint64_t &random,
+    std::vector<PathEntry> &path) const {
+  path.clear();
+  size_t cur = (NextRandom(random) & 1) ? i1 : i2;
+  for (size_t count = 0; count < kMaxCuckooCount; count++) {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      if (table_->ReadTag(cur, j) == 0) {
+        path.push_back({cur, j, 0});
+        return true;
+      }
+    }
+    // kick out a random tag, but not one that is already moved
+    size_t r = NextRandom(random) % kTagsPerBucket;
+    size_t slot = kTagsPerBucket;
+    for (size_t k = 0; k < kTagsPerBucket && slot == kTagsPerBucket; k++) {
+      size_t j = (r + k) % kTagsPerBucket;
+      bool used = false;
+      for (const PathEntry &e : path) {
+        used |= e.bucket == cur && e.slot == j;
+      }
+      if (!used) {
+        slot = j;
+      }
+    }
+    if (slot == kTagsPerBucket) {
+      return false;
+    }
+    uint32_t tag = table_->ReadTag(cur, slot);
+    path.push_back({cur, slot, tag});
+    cur = AltIndex(cur, tag);
+  }
+  return false;
+}
+
+// Move the tags along the path, last one first, to free the first slot.
+// Returns false if the table changed since the path was found.
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+bool CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::MoveAlongPath(
+    const std::vector<PathEntry> &path) {
+  for (size_t k = path.size() - 1; k > 0; k--) {
+    const PathEntry &from = path[k - 1];
+    const PathEntry &to = path[k];
+    LockTwo(from.bucket, to.bucket);
+    bool valid = table_->ReadTag(from.bucket, from.slot) == from.tag &&
+                 table_->ReadTag(to.bucket, to.slot) == 0;
+    if (valid) {
+      // the tag is in its other bucket before it leaves this one
+      table_->WriteTag(to.bucket, to.slot, from.tag);
+      table_->WriteTag(from.bucket, from.slot, 0);
+    }
+    UnlockTwo(from.bucket, to.bucket);
+    if (!valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::Add(
+    const ItemType &item) {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(item, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  uint64_t random = (uint64_t) i1 << 32 | tag;
+  std::vector<PathEntry> path;
+  for (int search = 0; search <= kMaxPathSearches; search++) {
+    LockTwo(i1, i2);
+    uint32_t unused;
+    bool inserted = table_->InsertTagToBucket(i1, tag, false, unused) ||
+                    table_->InsertTagToBucket(i2, tag, false, unused);
+    UnlockTwo(i1, i2);
+    if (inserted) {
+      __atomic_fetch_add(&num_items_, 1, __ATOMIC_RELAXED);
+      return Ok;
+    }
+    // free a slot of one of the buckets, then try again
+    if (search < kMaxPathSearches && FindPath(i1, i2, random, path)) {
+      MoveAlongPath(path);
+    }
+  }
+  return NotEnoughSpace;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::Contain(
+    const ItemType &key) const {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(key, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  assert(i1 == AltIndex(i2, tag));
+
+  const uint32_t *v1 = VersionOf(i1), *v2 = VersionOf(i2);
+  int spins = 0;
+  while (true) {
+    uint32_t s1 = __atomic_load_n(v1, __ATOMIC_ACQUIRE);
+    uint32_t s2 = __atomic_load_n(v2, __ATOMIC_ACQUIRE);
+    if ((s1 | s2) & 1) {
+      // a writer is changing one of the buckets
+      Backoff(spins);
+      continue;
+    }
+    // a tag that is found may come from a read that overlaps a write, but
+    // that is just another false positive; a key is only reported missing
+    // if no writer changed its buckets during the read
+    if (table_->FindTagInBuckets(i1, i2, tag)) {
+      return Ok;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(v1, __ATOMIC_RELAXED) == s1 &&
+        __atomic_load_n(v2, __ATOMIC_RELAXED) == s2) {
+      return NotFound;
+    }
+  }
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+Status CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::Delete(
+    const ItemType &key) {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(key, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  LockTwo(i1, i2);
+  bool deleted = table_->DeleteTagFromBucket(i1, tag) ||
+                 table_->DeleteTagFromBucket(i2, tag);
+  UnlockTwo(i1, i2);
+  if (!deleted) {
+    return NotFound;
+  }
+  __atomic_fetch_sub(&num_items_, 1, __ATOMIC_RELAXED);
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item, typename HashFamily>
+std::string CuckooFilterConcurrent<ItemType, bits_per_item, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "CuckooFilterConcurrent Status:\n"
+     << "\t\t" << table_->Info() << "\n"
+     << "\t\tLock stripes: " << num_stripes_ << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tLoad factor: " << LoadFactor() << "\n"
+     << "\t\tHashtable size: " << (table_->SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << BitsPerItem() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CUCKOO_FILTER_CONCURRENT_H_
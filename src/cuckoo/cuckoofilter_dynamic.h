@@ -0,0 +1,188 @@
+#ifndef CUCKOO_FILTER_CUCKOO_FILTER_DYNAMIC_H_
+#define CUCKOO_FILTER_CUCKOO_FILTER_DYNAMIC_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "hashutil.h"
+
+namespace cuckoofilter {
+
+// A cuckoo filter that grows with the number of keys (a dynamic cuckoo
+// filter, see Chen et al., "The dynamic cuckoo filter", 2017). It is a
+// chain of cuckoo filters: keys are added to the last one, and when it is
+// full (at the load CuckooFilter is sized for, 94% with 4 tags per
+// bucket), a new filter twice as large is appended. A lookup checks the
+// filters from the last (and largest) to the first, so with an initial
+// capacity c and n keys, it reads at most 1 + log2(n / c) filters. The
+// false positive rate is the sum of theirs: each doubling adds about the
+// rate of one full filter, which one more bit per item compensates.
+// Filters that become empty after deletions are released.
+//
+// Unlike with a single cuckoo filter, deleting a key may remove the tag of
+// another key, if the tag of the deleted key is a false positive of
+// another filter. Delete avoids this when the tag is only found in one
+// filter; otherwise, it deletes it from the oldest one.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTable,
+          typename HashFamily = hashing::TwoIndependentMultiplyShift>
+class CuckooFilterDynamic {
+  typedef CuckooFilter<ItemType, bits_per_item, TableType, HashFamily> Filter;
+
+  // the filters, oldest first, and the number of keys each can hold
+  std::vector<Filter *> filters_;
+  std::vector<size_t> capacities_;
+
+  // the hash functions of the filters are derived from this seed, and the
+  // number of filters created so far
+  uint64_t seed_;
+  uint64_t created_;
+
+  size_t initial_capacity_;
+
+  void Grow() {
+    // a power of two number of buckets, as full as CuckooFilter allows
+    const size_t assoc = Filter::kTagsPerBucket;
+    const double load = MaxLoadFactor(assoc);
+    size_t buckets = capacities_.empty()
+        ? upperpower2(std::max<uint64_t>(1, initial_capacity_ / assoc / load))
+        : 2 * filters_.back()->SizeInTags() / assoc;
+    size_t capacity = (size_t) (load * assoc * buckets);
+    filters_.push_back(new Filter(capacity, ::hashing::deriveSeed(seed_, created_++)));
+    capacities_.push_back(capacity);
+  }
+
+ public:
+  // A filter sized for initial_capacity keys at first; it grows as needed.
+  explicit CuckooFilterDynamic(const size_t initial_capacity,
+                               uint64_t seed = ::hashing::randomSeed())
+      : seed_(seed), created_(0),
+        initial_capacity_(std::max<size_t>(initial_capacity, 64)) {
+    Grow();
+  }
+
+  CuckooFilterDynamic(CuckooFilterDynamic &&o)
+      : filters_(std::move(o.filters_)), capacities_(std::move(o.capacities_)),
+        seed_(o.seed_), created_(o.created_),
+        initial_capacity_(o.initial_capacity_) {
+    o.filters_.clear();
+  }
+
+  ~CuckooFilterDynamic() {
+    for (Filter *f : filters_) {
+      delete f;
+    }
+  }
+
+  // Add an item to the filter. Always succeeds, growing the filter if
+  // needed.
+  Status Add(const ItemType &item);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Delete an key from the filter
+  Status Delete(const ItemType &item);
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const {
+    size_t size = 0;
+    for (const Filter *f : filters_) {
+      size += f->Size();
+    }
+    return size;
+  }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const {
+    size_t bytes = 0;
+    for (const Filter *f : filters_) {
+      bytes += f->SizeInBytes();
+    }
+    return bytes;
+  }
+
+  // number of chained filters
+  size_t FilterCount() const { return filters_.size(); }
+
+ private:
+  CuckooFilterDynamic(const CuckooFilterDynamic &) = delete;
+  CuckooFilterDynamic &operator=(const CuckooFilterDynamic &) = delete;
+};
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>::Add(
+    const ItemType &item) {
+  if (filters_.back()->Size() >= capacities_.back()) {
+    Grow();
+  }
+  if (filters_.back()->Add(item) == Ok) {
+    return Ok;
+  }
+  // the last filter is fuller than expected (or the item was added so many
+  // times that both of its buckets are full): a new filter has room
+  Grow();
+  return filters_.back()->Add(item);
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>::Contain(
+    const ItemType &key) const {
+  for (size_t i = filters_.size(); i-- > 0;) {
+    if (filters_[i]->Contain(key) == Ok) {
+      return Ok;
+    }
+  }
+  return NotFound;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>::Delete(
+    const ItemType &key) {
+  // the newest filter with the tag, unless an older one has it too
+  size_t found = filters_.size();
+  for (size_t i = filters_.size(); i-- > 0;) {
+    if (filters_[i]->Contain(key) == Ok) {
+      found = i;
+    }
+  }
+  if (found == filters_.size()) {
+    return NotFound;
+  }
+  filters_[found]->Delete(key);
+  // keep the last filter, as new keys go there
+  if (filters_[found]->Size() == 0 && found + 1 < filters_.size()) {
+    delete filters_[found];
+    filters_.erase(filters_.begin() + found);
+    capacities_.erase(capacities_.begin() + found);
+  }
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+std::string CuckooFilterDynamic<ItemType, bits_per_item, TableType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "CuckooFilterDynamic Status:\n"
+     << "\t\tFilters: " << FilterCount() << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tHashtable size: " << (SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << 8.0 * SizeInBytes() / Size() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CUCKOO_FILTER_DYNAMIC_H_
@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <algorithm>
 
+#include "cuckoofilter.h"
+#include "cuckoopath.h"
 #include "debug.h"
 #include "hashutil.h"
 #include "packedtable.h"
@@ -35,16 +37,11 @@ class CuckooFilterStable {
   // Number of items stored
   size_t num_items_;
 
-  typedef struct {
-    size_t index;
-    uint32_t tag;
-    bool used;
-  } VictimCache;
-
-  VictimCache victim_;
-
   HashFamily hasher_;
 
+  // scratch memory of the cuckoo path search
+  std::vector<BfsNode> bfs_queue_;
+
   inline size_t IndexHash(uint32_t hv) const {
     size_t x = reduce(hv, bucketCount);
     return x;
@@ -101,7 +98,7 @@ class CuckooFilterStable {
     return b2;
   }
 
-  Status AddImpl(const size_t i, const uint32_t tag);
+  Status AddImpl(const size_t i1, const size_t i2, const uint32_t tag);
 
   // load factor is the fraction of occupancy
   double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
@@ -109,22 +106,29 @@ class CuckooFilterStable {
   double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
 
  public:
-  explicit CuckooFilterStable(const size_t max_num_keys) : num_items_(0), victim_(), hasher_() {
-    size_t assoc = 4;
+  explicit CuckooFilterStable(const size_t max_num_keys, uint64_t seed = ::hashing::randomSeed())
+      : num_items_(0), hasher_(seed) {
+    size_t assoc = TableType<bits_per_item>::kTagsPerBucket;
     // bucket count needs to be even
-    bucketCount = (10 + max_num_keys / 0.94 / assoc) / 2 * 2;
-    victim_.used = false;
+    bucketCount = (10 + max_num_keys / MaxLoadFactor(assoc) / assoc) / 2 * 2;
     table_ = new TableType<bits_per_item>(bucketCount);
   }
 
   ~CuckooFilterStable() { delete table_; }
 
-  // Add an item to the filter.
+  // Add an item to the filter. Returns NotEnoughSpace if no cuckoo path
+  // was found; the filter is then unchanged.
   Status Add(const ItemType &item);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Report for n keys if they are inserted: out[i] is 1 if keys[i] may be
+  // in the filter, 0 otherwise. Keys are processed in groups; both buckets
+  // of all keys of a group are prefetched before they are read, so that
+  // the cache misses overlap.
+  void ContainBatch(const ItemType *keys, size_t n, uint8_t *out) const;
+
   // Delete an key from the filter
   Status Delete(const ItemType &item);
 
@@ -143,49 +147,36 @@ template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::Add(
     const ItemType &item) {
-  size_t i;
+  size_t i1, i2;
   uint32_t tag;
 
-  if (victim_.used) {
-    return NotEnoughSpace;
-  }
-
-  GenerateIndexTagHash(item, &i, &tag);
-  return AddImpl(i, tag);
+  GenerateIndexTagHash(item, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+  return AddImpl(i1, i2, tag);
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::AddImpl(
-    const size_t i, const uint32_t tag) {
-  size_t curindex = i;
-  uint32_t curtag = tag;
-  uint32_t oldtag;
-
-  for (uint32_t count = 0; count < kMaxCuckooCount; count++) {
-    bool kickout = count > 0;
-    oldtag = 0;
-    if (table_->InsertTagToBucket(curindex, curtag, kickout, oldtag)) {
-      num_items_++;
-      return Ok;
-    }
-    if (kickout) {
-      curtag = oldtag;
-    }
-    curindex = AltIndex(curindex, curtag);
+    const size_t i1, const size_t i2, const uint32_t tag) {
+  uint32_t unused;
+  if (table_->InsertTagToBucket(i1, tag, false, unused) ||
+      table_->InsertTagToBucket(i2, tag, false, unused)) {
+    num_items_++;
+    return Ok;
   }
-
-  victim_.index = curindex;
-  victim_.tag = curtag;
-  victim_.used = true;
-  return Ok;
+  auto altIndex = [this](size_t index, uint32_t t) { return AltIndex(index, t); };
+  if (InsertAlongShortestPath(table_, i1, i2, tag, altIndex, bfs_queue_)) {
+    num_items_++;
+    return Ok;
+  }
+  return NotEnoughSpace;
 }
 
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::Contain(
     const ItemType &key) const {
-  bool found = false;
   size_t i1, i2;
   uint32_t tag;
 
@@ -194,16 +185,34 @@ Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::Conta
 
   assert(i1 == AltIndex(i2, tag));
 
-  found = victim_.used && (tag == victim_.tag) &&
-          (i1 == victim_.index || i2 == victim_.index);
-
-  if (found || table_->FindTagInBuckets(i1, i2, tag)) {
+  if (table_->FindTagInBuckets(i1, i2, tag)) {
     return Ok;
   } else {
     return NotFound;
   }
 }
 
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::ContainBatch(
+    const ItemType *keys, size_t n, uint8_t *out) const {
+  size_t i1s[kContainBatchSize];
+  size_t i2s[kContainBatchSize];
+  uint32_t tags[kContainBatchSize];
+  for (size_t start = 0; start < n; start += kContainBatchSize) {
+    size_t len = std::min(kContainBatchSize, n - start);
+    for (size_t i = 0; i < len; i++) {
+      GenerateIndexTagHash(keys[start + i], &i1s[i], &tags[i]);
+      i2s[i] = AltIndex(i1s[i], tags[i]);
+      table_->PrefetchBucket(i1s[i]);
+      table_->PrefetchBucket(i2s[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+      out[start + i] = table_->FindTagInBuckets(i1s[i], i2s[i], tags[i]);
+    }
+  }
+}
+
 template <typename ItemType, size_t bits_per_item,
           template <size_t> class TableType, typename HashFamily>
 Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::Delete(
@@ -214,28 +223,12 @@ Status CuckooFilterStable<ItemType, bits_per_item, TableType, HashFamily>::Delet
   GenerateIndexTagHash(key, &i1, &tag);
   i2 = AltIndex(i1, tag);
 
-  if (table_->DeleteTagFromBucket(i1, tag)) {
-    num_items_--;
-    goto TryEliminateVictim;
-  } else if (table_->DeleteTagFromBucket(i2, tag)) {
+  if (table_->DeleteTagFromBucket(i1, tag) ||
+      table_->DeleteTagFromBucket(i2, tag)) {
     num_items_--;
-    goto TryEliminateVictim;
-  } else if (victim_.used && tag == victim_.tag &&
-             (i1 == victim_.index || i2 == victim_.index)) {
-    // num_items_--;
-    victim_.used = false;
     return Ok;
-  } else {
-    return NotFound;
-  }
-TryEliminateVictim:
-  if (victim_.used) {
-    victim_.used = false;
-    size_t i = victim_.index;
-    uint32_t tag = victim_.tag;
-    AddImpl(i, tag);
   }
-  return Ok;
+  return NotFound;
 }
 
 template <typename ItemType, size_t bits_per_item,
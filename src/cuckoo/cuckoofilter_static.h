@@ -0,0 +1,304 @@
+#ifndef CUCKOO_FILTER_CUCKOO_FILTER_STATIC_H_
+#define CUCKOO_FILTER_CUCKOO_FILTER_STATIC_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "cuckoofilter.h"
+#include "cuckoofilter_stable.h"
+#include "hashutil.h"
+
+namespace cuckoofilter {
+
+// construction fails after this many attempts with different seeds
+const int kStaticMaxAttempts = 20;
+
+// an empty slot, or no bucket, while building a static filter
+const uint32_t kStaticEmpty = UINT32_MAX;
+
+// the load factor a static filter is built at, by number of tags per
+// bucket: just below the load at which an assignment of all keys to one
+// of their two buckets stops existing (about 89.7%, 97.7%, 99.9% and
+// 99.99%)
+inline double StaticLoadFactor(size_t tags_per_bucket) {
+  return tags_per_bucket <= 2 ? 0.88
+      : (tags_per_bucket == 4 ? 0.97 : (tags_per_bucket == 8 ? 0.99 : 0.995));
+}
+
+// A cuckoo filter for a fixed set of keys, built at once by AddAll. It is
+// queried exactly like CuckooFilterStable (two buckets per key, any even
+// number of buckets), but as all keys are known, each is put in one of its
+// two buckets by bipartite matching rather than by random kicks: a key is
+// added to the emptier of its buckets if it has room, otherwise along the
+// shortest path of moves (an augmenting path) to a bucket with an empty
+// slot. This finds an assignment whenever one exists, so the table can be
+// filled almost to the threshold: 97% with 4 tags per bucket, and 99%
+// with 8 (see SingleTable8Way), against 94% for CuckooFilter.
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType = SingleTable,
+          typename HashFamily = hashing::TwoIndependentMultiplyShift>
+class CuckooFilterStatic {
+  static const size_t kTagsPerBucket = TableType<bits_per_item>::kTagsPerBucket;
+
+  // Storage of items
+  TableType<bits_per_item> *table_;
+  size_t bucketCount;
+
+  // Number of items stored
+  size_t num_items_;
+
+  HashFamily hasher_;
+  // the hash functions are derived from this seed
+  uint64_t seed_;
+
+  inline size_t IndexHash(uint32_t hv) const {
+    return reduce(hv, bucketCount);
+  }
+
+  inline uint32_t TagHash(uint32_t hv) const {
+    uint32_t tag;
+    tag = hv & ((1ULL << bits_per_item) - 1);
+    tag += (tag == 0);
+    return tag;
+  }
+
+  inline void GenerateIndexTagHash(const ItemType &item, size_t *index,
+                                   uint32_t *tag) const {
+    const uint64_t hash = hasher_(item);
+    *index = IndexHash((uint32_t) hash);
+    *tag = TagHash(hash >> 32);
+  }
+
+  // the same as CuckooFilterStable::AltIndex
+  inline size_t AltIndex(const size_t index, const uint32_t tag) const {
+    uint64_t hash = tag * 0xc4ceb9fe1a85ec53L;
+    uint32_t r = (reduce(hash, bucketCount >> 1) << 1) + 1;
+    int32_t b2 = bucketCount - index - r;
+    if (b2 < 0) {
+      b2 += bucketCount;
+    }
+    return b2;
+  }
+
+  // Assign keys [0, n) with buckets i1, i2 to slots (key indexes,
+  // kStaticEmpty if empty; kTagsPerBucket per bucket). Returns false if
+  // there is no assignment.
+  bool Assign(const std::vector<uint32_t> &i1, const std::vector<uint32_t> &i2,
+              std::vector<uint32_t> &slots) const;
+
+  double LoadFactor() const { return 1.0 * Size() / table_->SizeInTags(); }
+
+  double BitsPerItem() const { return 8.0 * table_->SizeInBytes() / Size(); }
+
+ public:
+  explicit CuckooFilterStatic(const size_t max_num_keys,
+                              uint64_t seed = ::hashing::randomSeed())
+      : num_items_(0), hasher_(seed), seed_(seed) {
+    double load = StaticLoadFactor(kTagsPerBucket);
+    // bucket count needs to be even
+    bucketCount = (2 + max_num_keys / load / kTagsPerBucket) / 2 * 2;
+    table_ = new TableType<bits_per_item>(bucketCount);
+  }
+
+  CuckooFilterStatic(CuckooFilterStatic &&o)
+      : table_(o.table_), bucketCount(o.bucketCount),
+        num_items_(o.num_items_), hasher_(o.hasher_), seed_(o.seed_) {
+    o.table_ = nullptr;
+  }
+
+  ~CuckooFilterStatic() { delete table_; }
+
+  // Build the filter from keys [start, end), at most max_num_keys of them.
+  // Returns NotEnoughSpace if no assignment was found (with many duplicate
+  // keys); the filter is then empty.
+  Status AddAll(const std::vector<ItemType> &keys, const size_t start,
+                const size_t end) {
+    return AddAll(keys.data(), start, end);
+  }
+
+  Status AddAll(const ItemType *keys, const size_t start, const size_t end);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Report for n keys if they are inserted, as CuckooFilter::ContainBatch.
+  void ContainBatch(const ItemType *keys, size_t n, uint8_t *out) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return num_items_; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return table_->SizeInBytes(); }
+
+ private:
+  CuckooFilterStatic(const CuckooFilterStatic &) = delete;
+  CuckooFilterStatic &operator=(const CuckooFilterStatic &) = delete;
+};
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+bool CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>::Assign(
+    const std::vector<uint32_t> &i1, const std::vector<uint32_t> &i2,
+    std::vector<uint32_t> &slots) const {
+  std::vector<uint8_t> used(bucketCount, 0);
+  // the search tree of the current key: for each bucket, the search that
+  // reached it last, and the bucket and key it was reached from
+  std::vector<uint32_t> visited(bucketCount, kStaticEmpty);
+  std::vector<uint32_t> fromBucket(bucketCount);
+  std::vector<uint32_t> fromKey(bucketCount);
+  std::vector<uint32_t> queue;
+  for (uint32_t k = 0; k < i1.size(); k++) {
+    uint32_t b = used[i1[k]] <= used[i2[k]] ? i1[k] : i2[k];
+    if (used[b] == kTagsPerBucket) {
+      // breadth-first search for a bucket with an empty slot; the first
+      // buckets are reached from no bucket
+      queue.clear();
+      b = kStaticEmpty;
+      for (uint32_t start : {i1[k], i2[k]}) {
+        if (visited[start] != k) {
+          visited[start] = k;
+          fromBucket[start] = kStaticEmpty;
+          queue.push_back(start);
+        }
+      }
+      for (size_t head = 0; head < queue.size() && b == kStaticEmpty; head++) {
+        uint32_t bucket = queue[head];
+        for (size_t j = 0; j < kTagsPerBucket; j++) {
+          uint32_t key = slots[bucket * kTagsPerBucket + j];
+          uint32_t other = i1[key] == bucket ? i2[key] : i1[key];
+          if (visited[other] == k) {
+            continue;
+          }
+          visited[other] = k;
+          fromBucket[other] = bucket;
+          fromKey[other] = key;
+          if (used[other] < kTagsPerBucket) {
+            b = other;
+            break;
+          }
+          queue.push_back(other);
+        }
+      }
+      if (b == kStaticEmpty) {
+        return false;
+      }
+      // move the keys along the path, last one first
+      while (fromBucket[b] != kStaticEmpty) {
+        uint32_t prev = fromBucket[b];
+        uint32_t key = fromKey[b];
+        slots[b * kTagsPerBucket + used[b]++] = key;
+        uint32_t *s = &slots[prev * kTagsPerBucket];
+        *std::find(s, s + kTagsPerBucket, key) = s[--used[prev]];
+        b = prev;
+      }
+    }
+    slots[b * kTagsPerBucket + used[b]++] = k;
+  }
+  return true;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>::AddAll(
+    const ItemType *keys, const size_t start, const size_t end) {
+  const size_t size = end - start;
+  std::vector<uint32_t> i1(size), i2(size), tags(size);
+  std::vector<uint32_t> slots(bucketCount * kTagsPerBucket);
+  delete table_;
+  table_ = new TableType<bits_per_item>(bucketCount);
+  num_items_ = 0;
+  bool ok = size <= bucketCount * kTagsPerBucket;
+  for (int attempt = 0; ok; ) {
+    for (size_t k = 0; k < size; k++) {
+      size_t index;
+      GenerateIndexTagHash(keys[start + k], &index, &tags[k]);
+      i1[k] = index;
+      i2[k] = AltIndex(index, tags[k]);
+    }
+    std::fill(slots.begin(), slots.end(), kStaticEmpty);
+    if (Assign(i1, i2, slots)) {
+      break;
+    }
+    if (++attempt == kStaticMaxAttempts) {
+      ok = false;
+      break;
+    }
+    // use a new random numbers
+    hasher_ = HashFamily(::hashing::deriveSeed(seed_, attempt));
+  }
+  if (!ok) {
+    return NotEnoughSpace;
+  }
+  uint32_t unused;
+  for (size_t s = 0; s < slots.size(); s++) {
+    if (slots[s] != kStaticEmpty) {
+      table_->InsertTagToBucket(s / kTagsPerBucket, tags[slots[s]], false,
+                                unused);
+    }
+  }
+  num_items_ = size;
+  return Ok;
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+Status CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>::Contain(
+    const ItemType &key) const {
+  size_t i1, i2;
+  uint32_t tag;
+
+  GenerateIndexTagHash(key, &i1, &tag);
+  i2 = AltIndex(i1, tag);
+
+  if (table_->FindTagInBuckets(i1, i2, tag)) {
+    return Ok;
+  } else {
+    return NotFound;
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+void CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>::ContainBatch(
+    const ItemType *keys, size_t n, uint8_t *out) const {
+  size_t i1s[kContainBatchSize];
+  size_t i2s[kContainBatchSize];
+  uint32_t tags[kContainBatchSize];
+  for (size_t start = 0; start < n; start += kContainBatchSize) {
+    size_t len = std::min(kContainBatchSize, n - start);
+    for (size_t i = 0; i < len; i++) {
+      GenerateIndexTagHash(keys[start + i], &i1s[i], &tags[i]);
+      i2s[i] = AltIndex(i1s[i], tags[i]);
+      table_->PrefetchBucket(i1s[i]);
+      table_->PrefetchBucket(i2s[i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+      out[start + i] = table_->FindTagInBuckets(i1s[i], i2s[i], tags[i]);
+    }
+  }
+}
+
+template <typename ItemType, size_t bits_per_item,
+          template <size_t> class TableType, typename HashFamily>
+std::string CuckooFilterStatic<ItemType, bits_per_item, TableType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "CuckooFilterStatic Status:\n"
+     << "\t\t" << table_->Info() << "\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tLoad factor: " << LoadFactor() << "\n"
+     << "\t\tHashtable size: " << (table_->SizeInBytes() >> 10) << " KB\n";
+  if (Size() > 0) {
+    ss << "\t\tbit/key:   " << BitsPerItem() << "\n";
+  } else {
+    ss << "\t\tbit/key:   N/A\n";
+  }
+  return ss.str();
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CUCKOO_FILTER_STATIC_H_
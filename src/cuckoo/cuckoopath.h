@@ -0,0 +1,95 @@
+#ifndef CUCKOO_FILTER_CUCKOO_PATH_H_
+#define CUCKOO_FILTER_CUCKOO_PATH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace cuckoofilter {
+
+// largest number of buckets visited by a search for a cuckoo path
+const size_t kMaxBfsBuckets = 1 << 12;
+
+// largest number of tags moved by a cuckoo path
+const int kMaxBfsDepth = 8;
+
+// a bucket reached by the search, and how: by moving tag out of the
+// bucket of node parent (-1 for the buckets of the new key)
+struct BfsNode {
+  size_t bucket;
+  int parent;
+  int depth;
+  uint32_t tag;
+};
+
+// Insert the tag into bucket i1 or i2, after moving other tags along the
+// shortest cuckoo path to a bucket with an empty slot (as in libcuckoo, see
+// Li et al., "Algorithmic improvements for fast concurrent cuckoo
+// hashing", 2014). The buckets are searched breadth-first; each bucket is
+// prefetched when it is queued, well before it is read.
+// Returns false, leaving the table unchanged, if no path was found.
+// altIndex(bucket, tag) is the other bucket of a tag; queue is scratch
+// memory, kept between calls.
+template <typename Table, typename AltIndex>
+bool InsertAlongShortestPath(Table *table, const size_t i1, const size_t i2,
+                             const uint32_t tag, const AltIndex &altIndex,
+                             std::vector<BfsNode> &queue) {
+  const size_t kTagsPerBucket = Table::kTagsPerBucket;
+  queue.clear();
+  queue.push_back({i1, -1, 0, 0});
+  if (i2 != i1) {
+    queue.push_back({i2, -1, 0, 0});
+  }
+  size_t head = 0;
+  for (; head < queue.size(); head++) {
+    const BfsNode node = queue[head];
+    uint32_t tags[kTagsPerBucket];
+    table->ReadBucket(node.bucket, tags);
+    bool empty = false;
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      empty |= tags[j] == 0;
+    }
+    if (empty) {
+      break;
+    }
+    if (node.depth == kMaxBfsDepth) {
+      continue;
+    }
+    for (size_t j = 0; j < kTagsPerBucket && queue.size() < kMaxBfsBuckets; j++) {
+      // equal tags lead to the same bucket
+      bool seen = false;
+      for (size_t k = 0; k < j; k++) {
+        seen |= tags[k] == tags[j];
+      }
+      size_t child = altIndex(node.bucket, tags[j]);
+      // a path must not go through a bucket twice
+      for (int p = (int) head; p >= 0 && !seen; p = queue[p].parent) {
+        seen = queue[p].bucket == child;
+      }
+      if (!seen) {
+        table->PrefetchBucket(child);
+        queue.push_back({child, (int) head, node.depth + 1, tags[j]});
+      }
+    }
+  }
+  if (head == queue.size()) {
+    return false;
+  }
+  // Move the tags, last one first: each move fills the slot emptied by the
+  // previous one, and empties a slot of the bucket before it on the path.
+  uint32_t unused;
+  for (int n = (int) head; queue[n].parent >= 0; n = queue[n].parent) {
+    const BfsNode &node = queue[n];
+    table->InsertTagToBucket(node.bucket, node.tag, false, unused);
+    table->DeleteTagFromBucket(queue[node.parent].bucket, node.tag);
+  }
+  size_t first = head;
+  while (queue[first].parent >= 0) {
+    first = queue[first].parent;
+  }
+  table->InsertTagToBucket(queue[first].bucket, tag, false, unused);
+  return true;
+}
+}  // namespace cuckoofilter
+#endif  // CUCKOO_FILTER_CUCKOO_PATH_H_
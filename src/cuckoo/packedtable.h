@@ -4,37 +4,118 @@
 #include <sstream>
 #include <utility>
 
+#include "allocation.h"
+#include "bitsutil.h"
 #include "debug.h"
 #include "permencoding.h"
 #include "printutil.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CUCKOO_PACKED_BMI2
+#include <immintrin.h>
+#endif
+
 namespace cuckoofilter {
 
 // Using Permutation encoding to save 1 bit per tag
 template <size_t bits_per_tag>
 class PackedTable {
+  // a bucket must fit in the 64 bits read at once
+  static_assert(bits_per_tag >= 5 && bits_per_tag <= 17,
+                "bits_per_tag must be between 5 and 17");
   static const size_t kDirBitsPerTag = bits_per_tag - 4;
   static const size_t kBitsPerBucket = (3 + kDirBitsPerTag) * 4;
   static const size_t kBytesPerBucket = (kBitsPerBucket + 7) >> 3;
   static const uint32_t kDirBitsMask = ((1ULL << kDirBitsPerTag) - 1) << 4;
 
+  // With BMI2, a bucket is decoded into four 16-bit lanes, one tag per
+  // lane: pdep spreads the direct bits of the tags and the low bits given
+  // by the codeword to their lanes, and the lanes are compared with a tag
+  // all at once. Encoding is the reverse, with pext. This works for any
+  // tag of up to 16 bits (12 direct bits).
+  static const bool kBmi2Fits = kDirBitsPerTag <= 12;
+  static const uint64_t kLaneLowMask = 0x000f000f000f000fULL;
+  static const uint64_t kLaneDirMask =
+      (((1ULL << kDirBitsPerTag) - 1) << 4) * 0x0001000100010001ULL;
+
   // using a pointer adds one more indirection
   size_t len_;
   size_t num_buckets_;
   char *buckets_;
+  ::allocation::Block memory_;
   PermEncoding perm_;
+  // whether to use the BMI2 code, chosen at runtime
+  bool bmi2_;
+
+  // the bits of bucket i, in the lowest kBitsPerBucket bits
+  inline uint64_t BucketBits(const size_t i) const {
+    const size_t bit = kBitsPerBucket * i;
+    return *((uint64_t *)(buckets_ + (bit >> 3))) >> (bit & 7);
+  }
+
+  // The codewords are indexed by the low bits of tags 0, 2, 1, 3 (in this
+  // order); swapping the two middle nibbles converts from the tag order.
+  static inline uint64_t SwapMiddleNibbles(const uint64_t x) {
+    return (x & 0xf00f) | ((x & 0x00f0) << 4) | ((x >> 4) & 0x00f0);
+  }
+
+#ifdef CUCKOO_PACKED_BMI2
+  __attribute__((target("bmi2")))
+  inline uint64_t DecodeBmi2(const uint64_t bucketbits) const {
+    uint64_t low = perm_.dec_table_ordered[bucketbits & 0x0fff];
+    return _pdep_u64(low, kLaneLowMask) |
+           _pdep_u64(bucketbits >> 12, kLaneDirMask);
+  }
+
+  __attribute__((target("bmi2")))
+  void ReadBucketBmi2(const size_t i, uint32_t tags[4]) const {
+    uint64_t lanes = DecodeBmi2(BucketBits(i));
+    tags[0] = lanes & 0xffff;
+    tags[1] = (lanes >> 16) & 0xffff;
+    tags[2] = (lanes >> 32) & 0xffff;
+    tags[3] = lanes >> 48;
+  }
+
+  __attribute__((target("bmi2")))
+  void WriteBucketBmi2(const size_t i, const uint32_t tags[4]) {
+    uint64_t lanes = tags[0] | ((uint64_t)tags[1] << 16) |
+                     ((uint64_t)tags[2] << 32) | ((uint64_t)tags[3] << 48);
+    uint64_t codeword =
+        perm_.enc_table[SwapMiddleNibbles(_pext_u64(lanes, kLaneLowMask))];
+    uint64_t bucketbits = codeword | (_pext_u64(lanes, kLaneDirMask) << 12);
+    const size_t bit = kBitsPerBucket * i;
+    uint64_t *p = (uint64_t *)(buckets_ + (bit >> 3));
+    const uint64_t mask = (~0ULL >> (64 - kBitsPerBucket)) << (bit & 7);
+    *p = (*p & ~mask) | (bucketbits << (bit & 7));
+  }
+
+  __attribute__((target("bmi2")))
+  bool FindTagInBucketsBmi2(const size_t i1, const size_t i2,
+                            const uint32_t tag) const {
+    uint64_t lanes1 = DecodeBmi2(BucketBits(i1));
+    uint64_t lanes2 = DecodeBmi2(BucketBits(i2));
+    return (hasvalue16(lanes1, tag) | hasvalue16(lanes2, tag)) != 0;
+  }
+#endif
 
  public:
+  static const size_t kTagsPerBucket = 4;
+
   explicit PackedTable(size_t num) : num_buckets_(num) {
     // NOTE(binfan): use 7 extra bytes to avoid overrun as we
     // always read a uint64
     len_ = kBytesPerBucket * num_buckets_ + 7;
-    buckets_ = new char[len_];
-    memset(buckets_, 0, len_); 
+    memory_ = ::allocation::allocate(len_);
+    buckets_ = reinterpret_cast<char *>(memory_.data);
+#ifdef CUCKOO_PACKED_BMI2
+    bmi2_ = kBmi2Fits && __builtin_cpu_supports("bmi2");
+#else
+    bmi2_ = false;
+#endif
   }
 
   ~PackedTable() { 
-    delete[] buckets_; 
+    ::allocation::deallocate(memory_);
   }
 
   size_t NumBuckets() const {
@@ -119,6 +200,13 @@ class PackedTable {
     DPRINTF(DEBUG_TABLE, "PackedTable::ReadBucket %zu \n", i);
     DPRINTF(DEBUG_TABLE, "kdirbitsMask=%x\n", kDirBitsMask);
 
+#ifdef CUCKOO_PACKED_BMI2
+    if (bmi2_) {
+      ReadBucketBmi2(i, tags);
+      return;
+    }
+#endif
+
     const char *p;  // =  buckets_ + ((kBitsPerBucket * i) >> 3);
     uint16_t codeword;
     uint8_t lowbits[4];
@@ -186,6 +274,15 @@ class PackedTable {
       tags[1] = (bucketbits >> 21) & kDirBitsMask;
       tags[2] = (bucketbits >> 34) & kDirBitsMask;
       tags[3] = (bucketbits >> 47) & kDirBitsMask;
+    } else {
+      // other widths: the bucket is shifted down from the 8 bytes it
+      // starts in (it starts at bit 0 or 4, so it always fits)
+      uint64_t bucketbits = BucketBits(i);
+      codeword = bucketbits & 0x0fff;
+      tags[0] = (bucketbits >> 8) & kDirBitsMask;
+      tags[1] = (bucketbits >> (8 + kDirBitsPerTag)) & kDirBitsMask;
+      tags[2] = (bucketbits >> (8 + 2 * kDirBitsPerTag)) & kDirBitsMask;
+      tags[3] = (bucketbits >> (8 + 3 * kDirBitsPerTag)) & kDirBitsMask;
     }
 
     /* codeword is the lowest 12 bits in the bucket */
@@ -220,6 +317,13 @@ class PackedTable {
       PrintTags(tags);
     }
 
+#ifdef CUCKOO_PACKED_BMI2
+    if (bmi2_) {
+      WriteBucketBmi2(i, tags);
+      return;
+    }
+#endif
+
     /* put in direct bits for each tag*/
 
     uint8_t lowbits[4];
@@ -303,13 +407,38 @@ class PackedTable {
                          ((uint64_t)highbits[1] << 21) |
                          ((uint64_t)highbits[2] << 34) |
                          ((uint64_t)highbits[3] << 47);
+    } else {
+      // other widths: the 8 bytes the bucket starts in are updated
+      uint64_t bucketbits = codeword | ((uint64_t)highbits[0] << 8) |
+                            ((uint64_t)highbits[1] << (8 + kDirBitsPerTag)) |
+                            ((uint64_t)highbits[2] << (8 + 2 * kDirBitsPerTag)) |
+                            ((uint64_t)highbits[3] << (8 + 3 * kDirBitsPerTag));
+      const size_t bit = kBitsPerBucket * i;
+      uint64_t *q = (uint64_t *)(buckets_ + (bit >> 3));
+      const uint64_t mask = (~0ULL >> (64 - kBitsPerBucket)) << (bit & 7);
+      *q = (*q & ~mask) | (bucketbits << (bit & 7));
     }
     DPRINTF(DEBUG_TABLE, "PackedTable::WriteBucket done\n");
   }
 
+  // the bucket is read as 8 bytes, which may cross a cache line
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_ + ((kBitsPerBucket * i) >> 3));
+    __builtin_prefetch(buckets_ + ((kBitsPerBucket * i) >> 3) + 7);
+  }
+
   bool FindTagInBuckets(const size_t i1, const size_t i2,
                         const uint32_t tag) const {
     //            DPRINTF(DEBUG_TABLE, "PackedTable::FindTagInBucket %zu\n", i);
+#ifdef CUCKOO_PACKED_BMI2
+    if (bmi2_) {
+      return FindTagInBucketsBmi2(i1, i2, tag);
+    }
+#endif
+    if (bits_per_tag != 13) {
+      // the code below reads the layout of 13-bit tags only
+      return FindTagInBucket(i1, tag) || FindTagInBucket(i2, tag);
+    }
     uint32_t tags1[4];
     uint32_t tags2[4];
 
@@ -345,9 +474,10 @@ class PackedTable {
     tags2[1] |= ((v >> 8) & 0x000f);
     tags2[3] |= ((v >> 12) & 0x000f);
 
-    return (tags1[0] == tag) || (tags1[1] == tag) || (tags1[2] == tag) ||
-           (tags1[3] == tag) || (tags2[0] == tag) || (tags2[1] == tag) ||
-           (tags2[2] == tag) || (tags2[3] == tag);
+    // no branches: the tags are compared all at once
+    return ((tags1[0] == tag) | (tags1[1] == tag) | (tags1[2] == tag) |
+            (tags1[3] == tag) | (tags2[0] == tag) | (tags2[1] == tag) |
+            (tags2[2] == tag) | (tags2[3] == tag)) != 0;
   }
 
   bool FindTagInBucket(const size_t i, const uint32_t tag) const {
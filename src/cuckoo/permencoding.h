@@ -38,6 +38,7 @@ class PermEncoding {
     uint8_t dst[4];
     uint16_t idx = 0;
     memset(dec_table, 0, sizeof(dec_table));
+    memset(dec_table_ordered, 0, sizeof(dec_table_ordered));
     memset(enc_table, 0, sizeof(enc_table));
     gen_tables(0, 0, dst, idx);
   }
@@ -47,6 +48,8 @@ class PermEncoding {
   static const size_t N_ENTS = 3876;
 
   uint16_t dec_table[N_ENTS];
+  // as dec_table, but with the four numbers in order (in nibbles 0 to 3)
+  uint16_t dec_table_ordered[N_ENTS];
   uint16_t enc_table[1 << 16];
 
   inline void decode(const uint16_t codeword, uint8_t lowbits[4]) const {
@@ -74,6 +77,8 @@ class PermEncoding {
         gen_tables(i, k + 1, dst, idx);
       } else {
         dec_table[idx] = pack(dst);
+        dec_table_ordered[idx] =
+            dst[0] | (dst[1] << 4) | (dst[2] << 8) | (dst[3] << 12);
         enc_table[pack(dst)] = idx;
         if (DEBUG_ENCODE & debug_level) {
           printf("enc_table[%04x]=%04x\t%x %x %x %x\n", pack(dst), idx, dst[0],
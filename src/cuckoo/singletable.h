@@ -5,40 +5,84 @@
 
 #include <sstream>
 
+#include "allocation.h"
 #include "bitsutil.h"
 #include "debug.h"
 #include "printutil.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace cuckoofilter {
 
-// the most naive table implementation: one huge bit array
-template <size_t bits_per_tag>
-class SingleTable {
-  static const size_t kTagsPerBucket = 4;
+// the smallest power of two that is at least x
+constexpr size_t RoundUpToPowerOfTwo(size_t x, size_t p = 1) {
+  return p >= x ? p : RoundUpToPowerOfTwo(x, 2 * p);
+}
+
+// The most naive table implementation: one huge bit array of buckets of
+// tags_per_bucket tags (2, 4, 8 or 16). More tags per bucket allow a
+// higher load factor (inserts fail at about 87%, 97%, 99.5% and 99.9%),
+// but a lookup compares more tags, so it needs about one more bit per tag
+// for the same false positive rate.
+//
+// If aligned is true, a bucket is padded to a power of two size (for
+// example, 8 tags of 16 bits use 16 bytes), so that buckets of up to 64
+// bytes never straddle two cache lines and a lookup misses the cache at
+// most once per bucket. Buckets of 8- to 32-bit tags with 8 or more tags
+// are matched with SSE2.
+template <size_t bits_per_tag, size_t tags_per_bucket, bool aligned>
+class BucketTable {
+  static_assert(tags_per_bucket == 2 || tags_per_bucket == 4 ||
+                    tags_per_bucket == 8 || tags_per_bucket == 16,
+                "tags_per_bucket must be 2, 4, 8 or 16");
+
+ public:
+  static const size_t kTagsPerBucket = tags_per_bucket;
+
+ private:
+  // the bytes holding the tags of a bucket, and the bucket size
+  static const size_t kTagBytes = (bits_per_tag * kTagsPerBucket + 7) >> 3;
   static const size_t kBytesPerBucket =
-      (bits_per_tag * kTagsPerBucket + 7) >> 3;
+      aligned ? RoundUpToPowerOfTwo(kTagBytes) : kTagBytes;
   static const uint32_t kTagMask = (1ULL << bits_per_tag) - 1;
   // NOTE: accomodate extra buckets if necessary to avoid overrun
   // as we always read a uint64
   static const size_t kPaddingBuckets =
     ((((kBytesPerBucket + 7) / 8) * 8) - 1) / kBytesPerBucket;
 
+  // whether a bucket fits the lanes of the hasvalue macros
+  static const bool kSwar = kTagsPerBucket <= 4 &&
+      (bits_per_tag == 4 || bits_per_tag == 8 || bits_per_tag == 12 ||
+       bits_per_tag == 16);
+  // the bits of a 64-bit word that belong to the bucket
+  static const uint64_t kSwarMask =
+      ~0ULL >> (64 - (kSwar ? bits_per_tag * kTagsPerBucket : 64));
+#ifdef __SSE2__
+  static const bool kSimd = kTagsPerBucket >= 8 &&
+      (bits_per_tag == 8 || bits_per_tag == 16 || bits_per_tag == 32);
+#else
+  static const bool kSimd = false;
+#endif
+
   struct Bucket {
     char bits_[kBytesPerBucket];
   } __attribute__((__packed__));
 
   // using a pointer adds one more indirection
   Bucket *buckets_;
+  ::allocation::Block memory_;
   size_t num_buckets_;
 
  public:
-  explicit SingleTable(const size_t num) : num_buckets_(num) {
-    buckets_ = new Bucket[num_buckets_ + kPaddingBuckets];
-    memset(buckets_, 0, kBytesPerBucket * (num_buckets_ + kPaddingBuckets));
+  explicit BucketTable(const size_t num) : num_buckets_(num) {
+    memory_ = ::allocation::allocate(kBytesPerBucket * (num_buckets_ + kPaddingBuckets));
+    buckets_ = reinterpret_cast<Bucket *>(memory_.data);
   }
 
-  ~SingleTable() { 
-    delete[] buckets_;
+  ~BucketTable() { 
+    ::allocation::deallocate(memory_);
   }
 
   size_t NumBuckets() const {
@@ -57,6 +101,7 @@ class SingleTable {
     std::stringstream ss;
     ss << "SingleHashtable with tag size: " << bits_per_tag << " bits \n";
     ss << "\t\tAssociativity: " << kTagsPerBucket << "\n";
+    ss << "\t\tBucket size: " << kBytesPerBucket << " bytes\n";
     ss << "\t\tTotal # of rows: " << num_buckets_ << "\n";
     ss << "\t\tTotal # slots: " << SizeInTags() << "\n";
     return ss.str();
@@ -68,7 +113,8 @@ class SingleTable {
     uint32_t tag;
     /* following code only works for little-endian */
     if (bits_per_tag == 2) {
-      tag = *((uint8_t *)p) >> (j * 2);
+      p += (j >> 2);
+      tag = *((uint8_t *)p) >> ((j & 3) << 1);
     } else if (bits_per_tag == 4) {
       p += (j >> 1);
       tag = *((uint8_t *)p) >> ((j & 1) << 2);
@@ -87,13 +133,28 @@ class SingleTable {
     return tag & kTagMask;
   }
 
+  // read the tags of bucket i
+  inline void ReadBucket(const size_t i, uint32_t tags[kTagsPerBucket]) const {
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      tags[j] = ReadTag(i, j);
+    }
+  }
+
+  // the bucket is read as at least 8 bytes, which may cross a cache line
+  inline void PrefetchBucket(const size_t i) const {
+    __builtin_prefetch(buckets_[i].bits_);
+    __builtin_prefetch(buckets_[i].bits_ + (kTagBytes < 8 ? 7 : kTagBytes - 1));
+  }
+
   // write tag to pos(i,j)
   inline void WriteTag(const size_t i, const size_t j, const uint32_t t) {
     char *p = buckets_[i].bits_;
     uint32_t tag = t & kTagMask;
     /* following code only works for little-endian */
     if (bits_per_tag == 2) {
-      *((uint8_t *)p) |= tag << (2 * j);
+      p += (j >> 2);
+      *((uint8_t *)p) &= ~(0x03 << ((j & 3) << 1));
+      *((uint8_t *)p) |= tag << ((j & 3) << 1);
     } else if (bits_per_tag == 4) {
       p += (j >> 1);
       if ((j & 1) == 0) {
@@ -123,57 +184,11 @@ class SingleTable {
 
   inline bool FindTagInBuckets(const size_t i1, const size_t i2,
                                const uint32_t tag) const {
-    const char *p1 = buckets_[i1].bits_;
-    const char *p2 = buckets_[i2].bits_;
-
-    uint64_t v1 = *((uint64_t *)p1);
-    uint64_t v2 = *((uint64_t *)p2);
-
-    // caution: unaligned access & assuming little endian
-    if (bits_per_tag == 4 && kTagsPerBucket == 4) {
-      return hasvalue4(v1, tag) || hasvalue4(v2, tag);
-    } else if (bits_per_tag == 8 && kTagsPerBucket == 4) {
-      return hasvalue8(v1, tag) || hasvalue8(v2, tag);
-    } else if (bits_per_tag == 12 && kTagsPerBucket == 4) {
-      return hasvalue12(v1, tag) || hasvalue12(v2, tag);
-    } else if (bits_per_tag == 16 && kTagsPerBucket == 4) {
-      return hasvalue16(v1, tag) || hasvalue16(v2, tag);
-    } else {
-      for (size_t j = 0; j < kTagsPerBucket; j++) {
-        if ((ReadTag(i1, j) == tag) || (ReadTag(i2, j) == tag)) {
-          return true;
-        }
-      }
-      return false;
-    }
+    return (MatchBucket(i1, tag) | MatchBucket(i2, tag)) != 0;
   }
 
   inline bool FindTagInBucket(const size_t i, const uint32_t tag) const {
-    // caution: unaligned access & assuming little endian
-    if (bits_per_tag == 4 && kTagsPerBucket == 4) {
-      const char *p = buckets_[i].bits_;
-      uint64_t v = *(uint64_t *)p;  // uint16_t may suffice
-      return hasvalue4(v, tag);
-    } else if (bits_per_tag == 8 && kTagsPerBucket == 4) {
-      const char *p = buckets_[i].bits_;
-      uint64_t v = *(uint64_t *)p;  // uint32_t may suffice
-      return hasvalue8(v, tag);
-    } else if (bits_per_tag == 12 && kTagsPerBucket == 4) {
-      const char *p = buckets_[i].bits_;
-      uint64_t v = *(uint64_t *)p;
-      return hasvalue12(v, tag);
-    } else if (bits_per_tag == 16 && kTagsPerBucket == 4) {
-      const char *p = buckets_[i].bits_;
-      uint64_t v = *(uint64_t *)p;
-      return hasvalue16(v, tag);
-    } else {
-      for (size_t j = 0; j < kTagsPerBucket; j++) {
-        if (ReadTag(i, j) == tag) {
-          return true;
-        }
-      }
-      return false;
-    }
+    return MatchBucket(i, tag) != 0;
   }
 
   inline bool DeleteTagFromBucket(const size_t i, const uint32_t tag) {
@@ -203,6 +218,49 @@ class SingleTable {
     return false;
   }
 
+  // non-zero if bucket i holds the tag; without branches
+  inline uint64_t MatchBucket(const size_t i, const uint32_t tag) const {
+    const char *p = buckets_[i].bits_;
+    if (kSwar) {
+      // caution: unaligned access & assuming little endian
+      uint64_t v = *((uint64_t *)p) & kSwarMask;
+      if (bits_per_tag == 4) {
+        return hasvalue4(v, tag);
+      } else if (bits_per_tag == 8) {
+        return hasvalue8(v, tag);
+      } else if (bits_per_tag == 12) {
+        return hasvalue12(v, tag);
+      } else {
+        return hasvalue16(v, tag);
+      }
+    }
+#ifdef __SSE2__
+    if (kSimd) {
+      __m128i t = bits_per_tag == 8    ? _mm_set1_epi8((char)tag)
+                  : bits_per_tag == 16 ? _mm_set1_epi16((short)tag)
+                                       : _mm_set1_epi32((int)tag);
+      __m128i eq = _mm_setzero_si128();
+      for (size_t k = 0; k < kTagBytes; k += 16) {
+        __m128i v = kTagBytes == 8 ? _mm_loadl_epi64((const __m128i *)p)
+                                   : _mm_loadu_si128((const __m128i *)(p + k));
+        if (bits_per_tag == 8) {
+          eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, t));
+        } else if (bits_per_tag == 16) {
+          eq = _mm_or_si128(eq, _mm_cmpeq_epi16(v, t));
+        } else {
+          eq = _mm_or_si128(eq, _mm_cmpeq_epi32(v, t));
+        }
+      }
+      return _mm_movemask_epi8(eq);
+    }
+#endif
+    uint64_t found = 0;
+    for (size_t j = 0; j < kTagsPerBucket; j++) {
+      found |= ReadTag(i, j) == tag;
+    }
+    return found;
+  }
+
   inline size_t NumTagsInBucket(const size_t i) const {
     size_t num = 0;
     for (size_t j = 0; j < kTagsPerBucket; j++) {
@@ -213,5 +271,21 @@ class SingleTable {
     return num;
   }
 };
+
+// four tags per bucket, packed
+template <size_t bits_per_tag>
+using SingleTable = BucketTable<bits_per_tag, 4, false>;
+
+// two tags per bucket, packed
+template <size_t bits_per_tag>
+using SingleTable2Way = BucketTable<bits_per_tag, 2, false>;
+
+// eight tags per bucket, aligned
+template <size_t bits_per_tag>
+using SingleTable8Way = BucketTable<bits_per_tag, 8, true>;
+
+// sixteen tags per bucket, aligned
+template <size_t bits_per_tag>
+using SingleTable16Way = BucketTable<bits_per_tag, 16, true>;
 }  // namespace cuckoofilter
 #endif  // CUCKOO_FILTER_SINGLE_TABLE_H_
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <algorithm>
 
+#include "allocation.h"
 #include "hashutil.h"
 
 using namespace std;
@@ -111,6 +112,7 @@ uint64_t getScaleFactor(int64_t multiply, int64_t divide) {
 
 typedef struct MultiStageMonotoneList {
     uint64_t* data;
+    allocation::Block memory;
     uint32_t dataBits;
     uint64_t startLevel1, startLevel2, startLevel3;
     int bitCount1, bitCount2, bitCount3;
@@ -208,8 +210,9 @@ void MultiStageMonotoneList_generate(MultiStageMonotoneList* list, uint32_t* dat
     list->dataBits = bitCount1 * count1 + bitCount2 * count2 + bitCount3 * count3;
     list->startLevel1 = pos;
     size_t wordlen = (list->dataBits + 63) / 64;
-    list->data = new uint64_t[wordlen];
-    memset(list->data,0,wordlen*sizeof(uint64_t)); // presumably this is needed
+    allocation::deallocate(list->memory);
+    list->memory = allocation::allocate(wordlen * sizeof(uint64_t));
+    list->data = (uint64_t*) list->memory.data;
     for (int i = 0; i < count1; i++) {
         pos = writeNumber(list->data, pos, group1[i], bitCount1);
     }
@@ -245,6 +248,7 @@ class GcsFilter {
   MultiStageMonotoneList monotoneList;
   int startBuckets;
   uint64_t* bucketData;
+  allocation::Block bucketMemory;
   size_t bucketDataBits;
 
   HashFamily hasher;
@@ -252,12 +256,16 @@ class GcsFilter {
   double BitsPerItem() const { return 8.0; }
 
  public:
-  explicit GcsFilter(const size_t len) : hasher() {
+  explicit GcsFilter(const size_t len, uint64_t seed = randomSeed()) : hasher(seed) {
+    bucketData = NULL;
+    bucketMemory.data = NULL;
+    monotoneList.data = NULL;
+    monotoneList.memory.data = NULL;
   }
 
   ~GcsFilter() {
-    delete[] bucketData;
-    delete[] monotoneList.data;
+    allocation::deallocate(bucketMemory);
+    allocation::deallocate(monotoneList.memory);
   }
 
   Status AddAll(const vector<ItemType> data, const size_t start, const size_t end);
@@ -304,8 +312,9 @@ Status GcsFilter<ItemType, bits_per_item, HashFamily>::AddAll(
     }
     qsort(data, len, sizeof(uint64_t), compare_uint64);
     size_t bucketslen = 10L * fingerprintBits * len / 64;
-    uint64_t* buckets = new uint64_t[bucketslen];
-    memset(buckets, 0, sizeof(uint64_t[bucketslen]));
+    allocation::deallocate(bucketMemory);
+    bucketMemory = allocation::allocate(bucketslen * sizeof(uint64_t));
+    uint64_t* buckets = (uint64_t*) bucketMemory.data;
     uint32_t* startList = new uint32_t[bucketCount + 1];
     memset(startList, 0, sizeof(uint32_t[bucketCount + 1]));
     int bucket = 0;
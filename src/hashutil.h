@@ -10,6 +10,33 @@
 #include <random>
 
 namespace hashing {
+// returns a random seed
+inline uint64_t randomSeed() {
+  ::std::random_device random;
+  uint64_t seed = random();
+  seed <<= 32;
+  seed |= random();
+  return seed;
+}
+
+// The seed of the index-th hash function derived from a seed (splitmix64).
+// Filters that retry construction with a new hash function use the seeds
+// derived from their seed, in order, so that construction is reproducible.
+inline uint64_t deriveSeed(uint64_t seed, uint64_t index) {
+  uint64_t z = seed + (index + 1) * UINT64_C(0x9E3779B97F4A7C15);
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+// The batched lookups (ContainBatch of the xor and fuse filters, GetBatch
+// of the retrieval map) work on groups of this many keys: the keys of a
+// group are hashed and all of their entries prefetched, then the entries
+// are read. The group is large enough to keep many cache misses in flight,
+// and small enough that the prefetched lines are still in the L1 cache
+// when they are read.
+const size_t containBatchSize = 32;
+
 // See Martin Dietzfelbinger, "Universal hashing and k-wise independent random
 // variables via integer arithmetic without primes".
 class TwoIndependentMultiplyShift {
@@ -27,6 +54,15 @@ class TwoIndependentMultiplyShift {
     }
   }
 
+  explicit TwoIndependentMultiplyShift(uint64_t seed) {
+    uint64_t index = 0;
+    for (auto v : {&multiply_, &add_}) {
+      *v = deriveSeed(seed, index++);
+      *v = *v << 64;
+      *v |= deriveSeed(seed, index++);
+    }
+  }
+
   inline uint64_t operator()(uint64_t key) const {
     return (add_ + multiply_ * static_cast<decltype(multiply_)>(key)) >> 64;
   }
@@ -43,6 +79,8 @@ class SimpleMixSplit {
     seed |= random();
   }
 
+  explicit SimpleMixSplit(uint64_t seed) : seed(seed) {}
+
   inline static uint64_t murmur64(uint64_t h) {
     h ^= h >> 33;
     h *= UINT64_C(0xff51afd7ed558ccd);
@@ -0,0 +1,98 @@
+#ifndef REPLICATED_H_
+#define REPLICATED_H_
+
+#include <utility>
+#include <vector>
+
+#include "allocation.h"
+
+namespace allocation {
+
+// One copy of a read-only filter per NUMA node, so that lookups only read
+// memory of the local node.
+//
+// The filter is built once, with Primary(), on the node of the calling
+// thread; Replicate() then copies it to each other node (moving the pages
+// of each copy with mbind). Lookups use Local(), the copy on the node of
+// the calling thread, which should be pinned to that node.
+//
+// Filter must have a copy constructor that copies its table, and a
+// Memory() method that returns the allocation::Block of its table. A
+// filter passed to the constructor as an rvalue is moved, not copied, if
+// Filter has a move constructor.
+template <typename Filter>
+class Replicated {
+ public:
+  // the arguments are passed to the constructor of the primary filter
+  template <typename... Args>
+  explicit Replicated(Args &&... args)
+      : replicas(numaNodeCount(), nullptr), home(currentNode()) {
+    if (home >= (int)replicas.size()) {
+      home = 0;
+    }
+    replicas[home] = new Filter(std::forward<Args>(args)...);
+  }
+
+  Replicated(Replicated &&o) : replicas(std::move(o.replicas)), home(o.home) {
+    o.replicas.clear();
+  }
+
+  ~Replicated() {
+    for (Filter *f : replicas) {
+      delete f;
+    }
+  }
+
+  // the filter to build
+  Filter &Primary() { return *replicas[home]; }
+
+  // Copy the primary filter to each other node that is online, replacing
+  // the previous copies. Returns false if some pages could not be moved.
+  bool Replicate() {
+    uint64_t mask = numaNodeMask();
+    bool ok = true;
+    for (int node = 0; node < (int)replicas.size(); node++) {
+      if (node == home || ((mask >> node) & 1) == 0) {
+        continue;
+      }
+      delete replicas[node];
+      replicas[node] = new Filter(*replicas[home]);
+      ok &= bindToNode(replicas[node]->Memory(), node);
+    }
+    return ok;
+  }
+
+  // the copy on the node of the calling thread, or the primary filter if
+  // there is none
+  const Filter &Local() const {
+    int node = currentNode();
+    if (node < (int)replicas.size() && replicas[node] != nullptr) {
+      return *replicas[node];
+    }
+    return *replicas[home];
+  }
+
+  // number of copies, including the primary filter
+  size_t Copies() const {
+    size_t result = 0;
+    for (Filter *f : replicas) {
+      result += f != nullptr;
+    }
+    return result;
+  }
+
+  // size of one copy in bytes (the memory used is Copies() times this)
+  size_t SizeInBytes() const { return replicas[home]->SizeInBytes(); }
+
+ private:
+  // indexed by node
+  std::vector<Filter *> replicas;
+  int home;
+
+  Replicated(const Replicated &) = delete;
+  Replicated &operator=(const Replicated &) = delete;
+};
+
+}  // namespace allocation
+
+#endif  // REPLICATED_H_
@@ -0,0 +1,273 @@
+#ifndef RIBBON_FILTER_RIBBON_H_
+#define RIBBON_FILTER_RIBBON_H_
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+
+#include "allocation.h"
+#include "hashutil.h"
+
+using namespace std;
+using namespace hashing;
+
+// Standard Ribbon filter (Dillinger and Walzer, "Ribbon filter: practically
+// smaller than Bloom and Xor", 2021).
+//
+// Each key is an equation over GF(2): a random band of CoeffType (64 or 128)
+// coefficients starting at a random row, equal to its bits-bit fingerprint.
+// The equations are solved with banded Gaussian elimination (insertion is
+// a few xors and shifts per key), then by back substitution. The solution
+// is stored column-major in blocks of one coefficient word per fingerprint
+// bit, so that a lookup reads bits words in (at most) two adjacent blocks.
+namespace ribbonfilter {
+// status returned by a ribbon filter operation
+enum Status {
+  Ok = 0,
+  NotFound = 1,
+  NotEnoughSpace = 2,
+  NotSupported = 3,
+};
+
+// construction fails after this many attempts with different seeds (when
+// there are too few rows for the keys, the equations overlap inconsistently
+// with every seed)
+const int maxAttempts = 100;
+
+inline int parity(uint64_t x) { return __builtin_parityll(x); }
+
+inline int parity(__uint128_t x) {
+  return __builtin_parityll((uint64_t) x ^ (uint64_t) (x >> 64));
+}
+
+inline int countTrailingZeros(uint64_t x) { return __builtin_ctzll(x); }
+
+inline int countTrailingZeros(__uint128_t x) {
+  return (uint64_t) x != 0 ? __builtin_ctzll((uint64_t) x)
+                           : 64 + __builtin_ctzll((uint64_t) (x >> 64));
+}
+
+// the coefficients of a key; the first one is always set
+inline void coefficients(uint64_t hash, uint64_t *c) {
+  *c = (hash * UINT64_C(0x9E3779B97F4A7C15)) | 1;
+}
+
+inline void coefficients(uint64_t hash, __uint128_t *c) {
+  *c = ((__uint128_t) (hash * UINT64_C(0xC2B2AE3D27D4EB4F)) << 64) |
+       (hash * UINT64_C(0x9E3779B97F4A7C15)) | 1;
+}
+
+// The number of rows, as a factor of the number of keys, so that
+// construction almost always succeeds at the first attempt. The overhead
+// needed grows with the logarithm of the number of keys, and shrinks with
+// the width: wider bands need less space, but make construction and
+// lookups slower.
+inline double sizeFactor(int width, size_t size) {
+  double digits = log10((double) std::max(size, (size_t) 1000));
+  return width == 64 ? 1 + 0.03 * digits - 0.04 : 1 + 0.01 * digits - 0.005;
+}
+
+template <typename ItemType, int bits, typename CoeffType = uint64_t,
+          typename HashFamily = SimpleMixSplit>
+class RibbonFilter {
+  static_assert(bits >= 1 && bits <= 32, "bits must be between 1 and 32");
+
+ public:
+  // the number of coefficients of a key
+  static const int width = 8 * sizeof(CoeffType);
+
+  size_t size;
+  // number of rows, a multiple of width
+  size_t rows;
+  // number of possible first rows of a key
+  size_t starts;
+  // (rows / width) blocks of bits words
+  CoeffType *data;
+  allocation::Block memory;
+
+  HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  inline uint32_t fingerprint(uint64_t hash) const {
+    uint64_t x = (hash ^ (hash >> 32)) * UINT64_C(0xFF51AFD7ED558CCD);
+    return (uint32_t) (x >> (64 - bits));
+  }
+
+  inline size_t start(uint64_t hash) const {
+    return (size_t) (((__uint128_t) hash * starts) >> 64);
+  }
+
+  explicit RibbonFilter(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
+    this->size = size;
+    size_t minRows = (size_t) (size * sizeFactor(width, size));
+    rows = (minRows + width - 1) / width * width + width;
+    starts = rows - width + 1;
+    memory = allocation::allocate(rows / width * bits * sizeof(CoeffType));
+    data = (CoeffType *) memory.data;
+  }
+
+  // Copy the filter, including its table.
+  RibbonFilter(const RibbonFilter &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    size = o.size;
+    rows = o.rows;
+    starts = o.starts;
+    memory = allocation::allocate(rows / width * bits * sizeof(CoeffType));
+    data = (CoeffType *) memory.data;
+    memcpy(data, o.data, rows / width * bits * sizeof(CoeffType));
+  }
+
+  ~RibbonFilter() {
+    allocation::deallocate(memory);
+    delete hasher;
+  }
+
+  // Build the filter. Returns NotEnoughSpace if the equations could not be
+  // solved: with too few rows, overlapping equations are inconsistent.
+  // Duplicate keys do not fail, their equations reduce to 0 = 0.
+  Status AddAll(const vector<ItemType> &data, const size_t start, const size_t end) {
+    return AddAll(data.data(), start, end);
+  }
+
+  Status AddAll(const ItemType* data, const size_t start, const size_t end);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return size; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return rows / width * bits * sizeof(CoeffType); }
+
+  // the memory of the table
+  const allocation::Block &Memory() const { return memory; }
+
+ private:
+  // add the equations of all keys; returns false if they are inconsistent
+  bool Band(const ItemType* keys, const size_t start, const size_t end,
+            CoeffType* coeffs, uint32_t* results) const;
+};
+
+template <typename ItemType, int bits, typename CoeffType, typename HashFamily>
+bool RibbonFilter<ItemType, bits, CoeffType, HashFamily>::Band(
+    const ItemType* keys, const size_t start, const size_t end,
+    CoeffType* coeffs, uint32_t* results) const {
+  for (size_t i = start; i < end; i++) {
+    uint64_t hash = (*hasher)(keys[i]);
+    size_t row = this->start(hash);
+    CoeffType c;
+    coefficients(hash, &c);
+    uint32_t r = fingerprint(hash);
+    while (true) {
+      if (coeffs[row] == 0) {
+        coeffs[row] = c;
+        results[row] = r;
+        break;
+      }
+      // eliminate the first coefficient
+      c ^= coeffs[row];
+      r ^= results[row];
+      if (c == 0) {
+        // the equation depends on the others: fail if it contradicts them
+        if (r != 0) {
+          return false;
+        }
+        break;
+      }
+      int shift = countTrailingZeros(c);
+      row += shift;
+      c >>= shift;
+    }
+  }
+  return true;
+}
+
+template <typename ItemType, int bits, typename CoeffType, typename HashFamily>
+Status RibbonFilter<ItemType, bits, CoeffType, HashFamily>::AddAll(
+    const ItemType* keys, const size_t start, const size_t end) {
+  CoeffType* coeffs = new CoeffType[rows];
+  uint32_t* results = new uint32_t[rows];
+  for (int hashIndex = 0; ; ) {
+    memset(coeffs, 0, sizeof(CoeffType) * rows);
+    if (Band(keys, start, end, coeffs, results)) {
+      break;
+    }
+    if (++hashIndex == maxAttempts) {
+      delete[] coeffs;
+      delete[] results;
+      return NotEnoughSpace;
+    }
+    // use a new random numbers
+    delete hasher;
+    hasher = new HashFamily(deriveSeed(seed, hashIndex));
+  }
+  // Back substitution, last row first. state[b] holds bit b of the
+  // solution of the current row (lowest bit) and of the following
+  // width - 1 rows; at the first row of a block, it is the block word.
+  CoeffType state[bits];
+  memset(state, 0, sizeof(state));
+  for (size_t row = rows; row-- > 0;) {
+    CoeffType c = coeffs[row];
+    // rows without equation are free: they are set to 0
+    uint32_t r = c == 0 ? 0 : results[row];
+    for (int b = 0; b < bits; b++) {
+      CoeffType s = state[b] << 1;
+      // the first coefficient is set, and multiplies the unknown bit
+      int bit = ((r >> b) & 1) ^ parity(c & s);
+      state[b] = s | (CoeffType) bit;
+    }
+    if (row % width == 0) {
+      memcpy(data + row / width * bits, state, sizeof(state));
+    }
+  }
+  delete[] coeffs;
+  delete[] results;
+  return Ok;
+}
+
+template <typename ItemType, int bits, typename CoeffType, typename HashFamily>
+Status RibbonFilter<ItemType, bits, CoeffType, HashFamily>::Contain(
+    const ItemType &key) const {
+  uint64_t hash = (*hasher)(key);
+  size_t row = start(hash);
+  CoeffType c;
+  coefficients(hash, &c);
+  const CoeffType* block = data + row / width * bits;
+  int offset = row % width;
+  uint32_t x = 0;
+  if (offset == 0) {
+    for (int b = 0; b < bits; b++) {
+      x |= (uint32_t) parity(block[b] & c) << b;
+    }
+  } else {
+    // the band spans two blocks
+    for (int b = 0; b < bits; b++) {
+      CoeffType w = (block[b] >> offset) | (block[bits + b] << (width - offset));
+      x |= (uint32_t) parity(w & c) << b;
+    }
+  }
+  return x == fingerprint(hash) ? Ok : NotFound;
+}
+
+template <typename ItemType, int bits, typename CoeffType, typename HashFamily>
+std::string RibbonFilter<ItemType, bits, CoeffType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "RibbonFilter Status:\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tWidth: " << width << "\n"
+     << "\t\tRows: " << rows << "\n";
+  return ss.str();
+}
+}  // namespace ribbonfilter
+#endif  // RIBBON_FILTER_RIBBON_H_
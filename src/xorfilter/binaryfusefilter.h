@@ -0,0 +1,370 @@
+#ifndef BINARY_FUSE_FILTER_H_
+#define BINARY_FUSE_FILTER_H_
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+#include "allocation.h"
+#include "hashutil.h"
+#include "xor_radix.h"
+#include "xor_scratch.h"
+
+using namespace std;
+using namespace hashing;
+
+// Binary fuse filters (Graf and Lemire, "Binary Fuse Filters: Fast and
+// Smaller Than Xor Filters", 2022).
+//
+// Like xor fuse filters, each key maps to Arity (3 or 4) consecutive
+// segments, but the segment length is a power of two chosen from the number
+// of keys, and the number of entries is adjusted to the number of keys. This
+// gives about 1.13 (3-wise) or 1.08 (4-wise) entries per key for large sets,
+// and filters of a few thousand keys do not need padding segments. Small
+// segments also keep the entries of a key close to each other, which makes
+// both construction and lookups more cache friendly.
+namespace binaryfusefilter {
+// status returned by a binary fuse filter operation
+enum Status {
+  Ok = 0,
+  NotFound = 1,
+  NotEnoughSpace = 2,
+  NotSupported = 3,
+};
+
+// the largest segment length
+const size_t maxSegmentLength = 1 << 18;
+// construction fails after this many attempts with different seeds
+const int maxAttempts = 100;
+
+// the segment length for the given number of keys (found experimentally)
+inline size_t calculateSegmentLength(int arity, size_t size) {
+  if (size <= 1) {
+    return 4;
+  }
+  double x = arity == 3 ? log((double) size) / log(3.33) + 2.25
+                        : log((double) size) / log(2.91) - 0.5;
+  int bits = x < 2 ? 2 : (int) floor(x);
+  return std::min(maxSegmentLength, (size_t) 1 << std::min(bits, 18));
+}
+
+// the number of entries per key for the given number of keys
+inline double calculateSizeFactor(int arity, size_t size) {
+  if (size <= 1) {
+    return 0;
+  }
+  if (arity == 3) {
+    return std::max(1.125, 0.875 + 0.25 * log(1000000.0) / log((double) size));
+  }
+  return std::max(1.075, 0.77 + 0.305 * log(600000.0) / log((double) size));
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily = TwoIndependentMultiplyShift, int Arity = 3>
+class BinaryFuseFilter {
+  static_assert(Arity == 3 || Arity == 4, "Arity must be 3 or 4");
+
+ public:
+
+  size_t size;
+  size_t arrayLength;
+  size_t segmentCount;
+  size_t segmentLength;
+  size_t segmentLengthMask;
+  uint64_t segmentCountLength;
+  FingerprintType *fingerprints;
+  allocation::Block memory;
+
+  HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  inline FingerprintType fingerprint(const uint64_t hash) const {
+    return (FingerprintType) (hash ^ (hash >> 32));
+  }
+
+  // The entries of a key: entry i is in segment (first segment + i). The
+  // offset within the first segment comes from the high bits of the hash,
+  // the other offsets from disjoint lower bits.
+  __attribute__((always_inline))
+  inline void getHashes(uint64_t hash, size_t *h) const {
+    uint64_t base = (uint64_t) (((__uint128_t) hash * segmentCountLength) >> 64);
+    h[0] = base;
+    h[1] = (base + segmentLength) ^ ((hash >> 18) & segmentLengthMask);
+    h[2] = (base + 2 * segmentLength) ^ (hash & segmentLengthMask);
+    if (Arity == 4) {
+      // the remaining bits overlap with the ones used for the first segment,
+      // so mix them first
+      uint64_t mixed = (hash * UINT64_C(0x9E3779B97F4A7C15)) >> 46;
+      h[3] = (base + 3 * segmentLength) ^ (mixed & segmentLengthMask);
+    }
+  }
+
+  explicit BinaryFuseFilter(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
+    this->size = size;
+    segmentLength = calculateSegmentLength(Arity, size);
+    segmentLengthMask = segmentLength - 1;
+    size_t capacity = (size_t) round(size * calculateSizeFactor(Arity, size));
+    size_t segments = (capacity + segmentLength - 1) / segmentLength;
+    segmentCount = segments > Arity - 1 ? segments - (Arity - 1) : 1;
+    arrayLength = (segmentCount + Arity - 1) * segmentLength;
+    segmentCountLength = segmentCount * segmentLength;
+    memory = allocation::allocate(arrayLength * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
+  }
+
+  // Copy the filter, including its table.
+  BinaryFuseFilter(const BinaryFuseFilter &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    size = o.size;
+    arrayLength = o.arrayLength;
+    segmentCount = o.segmentCount;
+    segmentLength = o.segmentLength;
+    segmentLengthMask = o.segmentLengthMask;
+    segmentCountLength = o.segmentCountLength;
+    memory = allocation::allocate(arrayLength * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
+    memcpy(fingerprints, o.fingerprints, arrayLength * sizeof(FingerprintType));
+  }
+
+  ~BinaryFuseFilter() {
+    allocation::deallocate(memory);
+    delete hasher;
+  }
+
+  Status AddAll(const vector<ItemType> &data, const size_t start, const size_t end) {
+      return AddAll(data.data(), start, end);
+  }
+
+  Status AddAll(const ItemType* data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAll(data, start, end, scratch);
+  }
+
+  // Same as AddAll, but the temporary buffers are taken from (and kept in)
+  // the given scratch memory, so that they can be reused by the next build.
+  // Duplicate keys are allowed. Returns NotEnoughSpace if the filter could
+  // not be built (which is very unlikely).
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                xorscratch::Scratch &scratch) {
+      return Build(data, start, end, scratch, false);
+  }
+
+  // Same as AddAll, but the hashes are first sorted by segment, so that
+  // counting and peeling access the table almost sequentially. This is
+  // much faster once the table no longer fits in the cache.
+  Status AddAllSorted(const ItemType* data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAllSorted(data, start, end, scratch);
+  }
+
+  Status AddAllSorted(const ItemType* data, const size_t start, const size_t end,
+                      xorscratch::Scratch &scratch) {
+      return Build(data, start, end, scratch, true);
+  }
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return size; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return arrayLength * sizeof(FingerprintType); }
+
+  // the memory of the table
+  const allocation::Block &Memory() const { return memory; }
+
+ private:
+  Status Build(const ItemType* data, const size_t start, const size_t end,
+               xorscratch::Scratch &scratch, bool sort);
+};
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily, int Arity>
+Status BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>::Build(
+    const ItemType* keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch, bool sort) {
+    const size_t n = end - start;
+    uint64_t* hashes = scratch.get<uint64_t>(xorscratch::Hashes, n);
+    uint64_t* tmp = sort ? scratch.get<uint64_t>(xorscratch::Tmp, n) : nullptr;
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, n);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, n);
+    // for each entry, the xor of the hashes of its keys, and the number of
+    // keys times 4, xor the index (0..3) of the entry in each key
+    uint64_t* t2hash = scratch.get<uint64_t>(xorscratch::T2Vals, arrayLength);
+    uint8_t* t2count = scratch.get<uint8_t>(xorscratch::T2Counts, arrayLength);
+    uint32_t* alone = scratch.get<uint32_t>(xorscratch::Alone, arrayLength);
+    size_t h[4];
+    size_t reverseOrderPos = 0;
+    // duplicate keys have the same hash whatever the seed, so they can not
+    // be peeled; once found, the hashes are deduplicated
+    bool dedupe = false;
+    for (int hashIndex = 0; ; ) {
+        memset(t2hash, 0, sizeof(uint64_t) * arrayLength);
+        memset(t2count, 0, arrayLength);
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = (*hasher)(keys[start + i]);
+        }
+        // the number of distinct hashes
+        size_t count = n;
+        const uint64_t* sorted = hashes;
+        if (dedupe) {
+            // fully sorted, so also sorted by segment
+            std::sort(hashes, hashes + n);
+            count = std::unique(hashes, hashes + n) - hashes;
+        } else if (sort) {
+            sorted = xorradix::sortByHighBits(hashes, tmp, n,
+                                              xorradix::bitsFor(segmentCount));
+        }
+        // an entry can count at most 63 keys
+        bool overflow = false;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t hash = sorted[i];
+            getHashes(hash, h);
+            for (int hi = 0; hi < Arity; hi++) {
+                overflow |= t2count[h[hi]] >= 252;
+                t2count[h[hi]] += 4;
+                t2count[h[hi]] ^= hi;
+                t2hash[h[hi]] ^= hash;
+            }
+        }
+        size_t alonePos = 0;
+        for (size_t i = 0; i < arrayLength && !overflow; i++) {
+            if ((t2count[i] >> 2) == 1) {
+                alone[alonePos++] = i;
+            }
+        }
+        reverseOrderPos = 0;
+        while (alonePos > 0) {
+            size_t i = alone[--alonePos];
+            if ((t2count[i] >> 2) != 1) {
+                continue;
+            }
+            uint64_t hash = t2hash[i];
+            // the low bits are the index of the only key left
+            int found = t2count[i] & 3;
+            t2count[i] = 0;
+            reverseOrder[reverseOrderPos] = hash;
+            reverseH[reverseOrderPos] = (uint8_t) found;
+            reverseOrderPos++;
+            getHashes(hash, h);
+            for (int hi = 0; hi < Arity; hi++) {
+                if (hi == found) {
+                    continue;
+                }
+                t2count[h[hi]] -= 4;
+                t2count[h[hi]] ^= hi;
+                t2hash[h[hi]] ^= hash;
+                if ((t2count[h[hi]] >> 2) == 1) {
+                    alone[alonePos++] = h[hi];
+                }
+            }
+        }
+        if (reverseOrderPos == count) {
+            break;
+        }
+        if (!dedupe) {
+            // check for duplicates before trying another seed; reverseOrder
+            // is overwritten by the next attempt anyway
+            std::copy(sorted, sorted + n, reverseOrder);
+            std::sort(reverseOrder, reverseOrder + n);
+            if (std::adjacent_find(reverseOrder, reverseOrder + n) !=
+                reverseOrder + n) {
+                dedupe = true;
+                continue;
+            }
+        }
+        if (++hashIndex == maxAttempts) {
+            return NotEnoughSpace;
+        }
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+
+    for (size_t i = reverseOrderPos; i-- > 0;) {
+        // the hash of the key we insert next
+        uint64_t hash = reverseOrder[i];
+        int found = reverseH[i];
+        getHashes(hash, h);
+        // we set the entry found to the fingerprint of the key, xor the
+        // other entries, which are already set
+        FingerprintType xor2 = fingerprint(hash);
+        for (int hi = 0; hi < Arity; hi++) {
+            if (hi != found) {
+                xor2 ^= fingerprints[h[hi]];
+            }
+        }
+        fingerprints[h[found]] = xor2;
+    }
+    return Ok;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily, int Arity>
+Status BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>::Contain(
+    const ItemType &key) const {
+    uint64_t hash = (*hasher)(key);
+    FingerprintType f = fingerprint(hash);
+    size_t h[4];
+    getHashes(hash, h);
+    f ^= fingerprints[h[0]] ^ fingerprints[h[1]] ^ fingerprints[h[2]];
+    if (Arity == 4) {
+        f ^= fingerprints[h[3]];
+    }
+    return f == 0 ? Ok : NotFound;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily, int Arity>
+void BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    size_t h[4];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            getHashes(hash, h);
+            for (int hi = 0; hi < Arity; hi++) {
+                __builtin_prefetch(fingerprints + h[hi]);
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = fingerprint(hash);
+            getHashes(hash, h);
+            for (int hi = 0; hi < Arity; hi++) {
+                f ^= fingerprints[h[hi]];
+            }
+            out[start + i] = f == 0;
+        }
+    }
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily, int Arity>
+std::string BinaryFuseFilter<ItemType, FingerprintType, HashFamily, Arity>::Info() const {
+  std::stringstream ss;
+  ss << "BinaryFuseFilter Status:\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tArity: " << Arity << "\n"
+     << "\t\tSegment length: " << segmentLength << "\n"
+     << "\t\tSegments: " << segmentCount << "\n";
+  return ss.str();
+}
+}  // namespace binaryfusefilter
+#endif  // BINARY_FUSE_FILTER_H_
@@ -1,28 +1,42 @@
 #ifndef NBIT_ARRAY_H_
 #define NBIT_ARRAY_H_
 
+#include <stdint.h>
+#include <string.h>
+
+#include "allocation.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 //namespace nbit_array {
 
 template <typename ItemType>
 class UIntArray {
     size_t byteCount;
     ItemType* data;
+    allocation::Block memory;
 public:
     UIntArray(size_t size) {
         byteCount = sizeof(ItemType[size]);
-        data = new ItemType[size]();
+        memory = allocation::allocate(byteCount);
+        data = (ItemType*) memory.data;
     }
     ~UIntArray() {
-        delete[] data;
+        allocation::deallocate(memory);
     }
     inline ItemType get(size_t index) {
         return data[index];
     }
+    inline void prefetch(size_t index) {
+        __builtin_prefetch(data + index);
+    }
     inline void set(size_t index, ItemType value) {
         data[index] = value;
     }
-    void bulkSet(uint16_t* source, size_t length) {
-        for(int i = 0; i < length; i++) {
+    template <typename SourceType>
+    void bulkSet(const SourceType* source, size_t length) {
+        for(size_t i = 0; i < length; i++) {
             data[i] = source[i];
         }
     }
@@ -37,13 +51,15 @@ public:
 class UInt12Array {
     size_t byteCount;
     uint8_t* data;
+    allocation::Block memory;
 public:
     UInt12Array(size_t size) {
         byteCount = size * 3 / 2 + 32;
-        data = new uint8_t[byteCount]();
+        memory = allocation::allocate(byteCount);
+        data = (uint8_t*) memory.data;
     }
     ~UInt12Array() {
-        delete[] data;
+        allocation::deallocate(memory);
     }
     // the returned value may contain other high-order bits;
     // call mask() to clear them
@@ -53,8 +69,12 @@ public:
         memcpy(&word, data + firstBytePos, sizeof(uint16_t));
         return word >> ((index & 1) << 2);
     }
+    inline void prefetch(size_t index) {
+        __builtin_prefetch(data + (index * 3) / 2);
+    }
 
-    void bulkSet(uint16_t* source, size_t length) {
+    template <typename SourceType>
+    void bulkSet(const SourceType* source, size_t length) {
         assert((length / 2)*3 + (length % 1) * 2 <= byteCount);
         size_t i = 0, j = 0;
         for(; i + 1 < length;) {
@@ -94,13 +114,15 @@ public:
 class UInt10Array {
     size_t byteCount;
     uint64_t* data;
+    allocation::Block memory;
 public:
     UInt10Array(size_t size) {
         byteCount = size / 6 * 8;
-        data = new uint64_t[(byteCount + 7) / 8]();
+        memory = allocation::allocate((byteCount + 7) / 8 * 8);
+        data = (uint64_t*) memory.data;
     }
     ~UInt10Array() {
-        delete[] data;
+        allocation::deallocate(memory);
     }
     // the returned value may contain other high-order bits;
     // call mask() to clear them
@@ -110,7 +132,11 @@ public:
         int m = 3 * (index % 2) + (index % 3);
         return x >> (10 * m);
     }
-    void bulkSet(uint16_t* source, size_t length) {
+    inline void prefetch(size_t index) {
+        __builtin_prefetch(data + index / 6);
+    }
+    template <typename SourceType>
+    void bulkSet(const SourceType* source, size_t length) {
         for(size_t index = 0; index < length; index++) {
             set(index, source[index]);
         }
@@ -132,13 +158,15 @@ template <typename ItemType, size_t bitsPerEntry, uint32_t bitMask = (1 << bitsP
 class NBitArray {
     size_t byteCount;
     uint8_t* data;
+    allocation::Block memory;
 public:
     NBitArray(size_t size) {
         byteCount = (size * bitsPerEntry + 63 + 128) / 64 * 64 / 8;
-        data = new uint8_t[byteCount]();
+        memory = allocation::allocate(byteCount);
+        data = (uint8_t*) memory.data;
     }
     ~NBitArray() {
-        delete[] data;
+        allocation::deallocate(memory);
     }
     inline ItemType get(size_t index) {
         size_t bitPos = index * bitsPerEntry;
@@ -146,7 +174,11 @@ public:
         uint32_t word = __builtin_bswap32(*((uint32_t*) (data + firstBytePos))) >> 8;
         return (ItemType) ((word >> (24 - bitsPerEntry - (bitPos & 7))) & bitMask);
     }
-    void bulkSet(uint16_t* source, size_t length) {
+    inline void prefetch(size_t index) {
+        __builtin_prefetch(data + ((index * bitsPerEntry) >> 3));
+    }
+    template <typename SourceType>
+    void bulkSet(const SourceType* source, size_t length) {
         for(size_t i = 0; i < length; i++) {
             set(i, source[i]);
         }
@@ -169,6 +201,119 @@ public:
     }
 };
 
+// Entries of any width from 1 to 32 bits, packed without gaps: entry i is
+// at bits [i * bitsPerEntry, (i + 1) * bitsPerEntry) of the array, least
+// significant bit first. Reading an entry is one unaligned 64-bit load and
+// a shift. With BMI2, bulkSet packs a 64-bit word of source values at a
+// time with pext, and bulkGet unpacks them with pdep.
+template <size_t bitsPerEntry>
+class PackedBitArray {
+    static_assert(bitsPerEntry >= 1 && bitsPerEntry <= 32,
+                  "bitsPerEntry must be between 1 and 32");
+    static const uint64_t bitMask = (UINT64_C(1) << bitsPerEntry) - 1;
+    size_t byteCount;
+    uint8_t* data;
+    allocation::Block memory;
+
+    // Append the lowest bits of value to the word being written; full
+    // words are written to out.
+    static inline void append(uint64_t value, int bits, uint64_t &word,
+                              int &fill, uint8_t* &out) {
+        word |= value << fill;
+        fill += bits;
+        if (fill >= 64) {
+            memcpy(out, &word, sizeof(word));
+            out += sizeof(word);
+            fill -= 64;
+            word = fill == 0 ? 0 : value >> (bits - fill);
+        }
+    }
+
+public:
+    PackedBitArray(size_t size) {
+        byteCount = (size * bitsPerEntry + 7) / 8;
+        // padding, so that get can always load 8 bytes
+        memory = allocation::allocate(byteCount + sizeof(uint64_t));
+        data = (uint8_t*) memory.data;
+    }
+    ~PackedBitArray() {
+        allocation::deallocate(memory);
+    }
+    // the returned value may contain other high-order bits;
+    // call mask() to clear them
+    inline uint32_t get(size_t index) {
+        size_t bitPos = index * bitsPerEntry;
+        uint64_t word;
+        memcpy(&word, data + (bitPos >> 3), sizeof(word));
+        return (uint32_t) (word >> (bitPos & 7));
+    }
+    inline void prefetch(size_t index) {
+        __builtin_prefetch(data + ((index * bitsPerEntry) >> 3));
+    }
+    inline void set(size_t index, uint32_t value) {
+        size_t bitPos = index * bitsPerEntry;
+        int shift = bitPos & 7;
+        uint64_t word;
+        memcpy(&word, data + (bitPos >> 3), sizeof(word));
+        word &= ~(bitMask << shift);
+        word |= (value & bitMask) << shift;
+        memcpy(data + (bitPos >> 3), &word, sizeof(word));
+    }
+    // Set the first length entries; the array must be empty.
+    template <typename SourceType>
+    void bulkSet(const SourceType* source, size_t length) {
+        static_assert(bitsPerEntry <= 8 * sizeof(SourceType),
+                      "the source values are too narrow");
+        uint64_t word = 0;
+        int fill = 0;
+        uint8_t* out = data;
+        size_t i = 0;
+#ifdef __BMI2__
+        // the values of a 64-bit word of the source, packed
+        const int lanes = sizeof(uint64_t) / sizeof(SourceType);
+        uint64_t laneMask = 0;
+        for (int l = 0; l < lanes; l++) {
+            laneMask |= bitMask << (l * 8 * sizeof(SourceType));
+        }
+        for (; i + lanes <= length; i += lanes) {
+            uint64_t x;
+            memcpy(&x, source + i, sizeof(x));
+            append(_pext_u64(x, laneMask), lanes * bitsPerEntry, word, fill, out);
+        }
+#endif
+        for (; i < length; i++) {
+            append(source[i] & bitMask, bitsPerEntry, word, fill, out);
+        }
+        memcpy(out, &word, (fill + 7) / 8);
+    }
+    // Get the first length entries.
+    void bulkGet(uint32_t* target, size_t length) {
+        size_t i = 0;
+#ifdef __BMI2__
+        // two entries at a time, from one unaligned load
+        if (2 * bitsPerEntry <= 57) {
+            const uint64_t laneMask = bitMask | (bitMask << 32);
+            for (; i + 2 <= length; i += 2) {
+                size_t bitPos = i * bitsPerEntry;
+                uint64_t word;
+                memcpy(&word, data + (bitPos >> 3), sizeof(word));
+                uint64_t x = _pdep_u64(word >> (bitPos & 7), laneMask);
+                memcpy(target + i, &x, sizeof(x));
+            }
+        }
+#endif
+        for (; i < length; i++) {
+            target[i] = mask(get(i));
+        }
+    }
+    inline uint32_t mask(uint32_t fingerprint) {
+        return fingerprint & bitMask;
+    }
+    size_t getByteCount() {
+        return byteCount;
+    }
+};
+
 // }  // namespace n_bit_array
 
 #endif  // NBIT_ARRAY_H_
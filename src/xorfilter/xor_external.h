@@ -0,0 +1,326 @@
+#ifndef XOR_EXTERNAL_H_
+#define XOR_EXTERNAL_H_
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "xor_fuse_filter.h"
+
+// External-memory construction of xor fuse filters.
+//
+// The keys are read from a file, and the filter is written to a file (in
+// the format of xor_file.h, so that it can be mapped with the XorFuseFilter
+// constructor that takes a path). Neither the keys nor the fingerprints
+// are held in memory: the table is split into shards, the hashes of the
+// keys are spilled to one temporary file per shard, then the shards are
+// peeled one at a time and appended to the filter file. The number of
+// shards is chosen so that the memory used stays within a given budget,
+// whatever the number of keys.
+namespace xorfusefilter {
+
+// bytes read from the key file at a time
+const size_t externalReadBytes = 1 << 20;
+// largest and smallest buffer per shard, used to spill the hashes
+const size_t externalMaxBufferBytes = 1 << 16;
+const size_t externalMinBufferBytes = 1 << 12;
+// a build with duplicate keys never succeeds; give up after this many
+// attempts with different seeds
+const int externalMaxAttempts = 10;
+
+// temporary memory needed to peel a shard
+template <typename FingerprintType>
+size_t peelBytes(size_t keys, size_t entries) {
+    return keys * (2 * sizeof(uint64_t) + sizeof(uint8_t)) +
+           entries * (sizeof(t2val_t) + sizeof(int) + sizeof(FingerprintType));
+}
+
+// an upper bound of the number of keys of a shard (almost always)
+inline size_t maxShardKeys(size_t size, size_t shards) {
+    double mean = (double) size / shards;
+    return (size_t) (mean + 7 * sqrt(mean)) + 64;
+}
+
+// write or read all bytes at the given offset
+inline bool pwriteFully(int fd, const void* data, size_t bytes, off_t offset) {
+    const char* p = (const char*) data;
+    while (bytes > 0) {
+        ssize_t done = pwrite(fd, p, bytes, offset);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        if (done <= 0) {
+            return false;
+        }
+        p += done;
+        bytes -= done;
+        offset += done;
+    }
+    return true;
+}
+
+inline bool preadFully(int fd, void* data, size_t bytes, off_t offset) {
+    char* p = (char*) data;
+    while (bytes > 0) {
+        ssize_t done = pread(fd, p, bytes, offset);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        if (done <= 0) {
+            return false;
+        }
+        p += done;
+        bytes -= done;
+        offset += done;
+    }
+    return true;
+}
+
+// The temporary files of the shards. They are unlinked when they are
+// created, so they are removed when closed, even if the process dies.
+class ShardFiles {
+ public:
+  ShardFiles() {}
+
+  ~ShardFiles() {
+    for (int fd : fds) {
+      close(fd);
+    }
+  }
+
+  // Create count files in the given directory. Returns false on failure.
+  bool Create(const char* dir, size_t count) {
+    std::string pattern = std::string(dir) + "/xorfuseXXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back(0);
+    for (size_t i = 0; i < count; i++) {
+      memcpy(path.data(), pattern.c_str(), pattern.size());
+      int fd = mkstemp(path.data());
+      if (fd < 0) {
+        return false;
+      }
+      unlink(path.data());
+      fds.push_back(fd);
+    }
+    return true;
+  }
+
+  int operator[](size_t i) const { return fds[i]; }
+
+ private:
+  std::vector<int> fds;
+
+  ShardFiles(const ShardFiles&) = delete;
+  ShardFiles& operator=(const ShardFiles&) = delete;
+};
+
+// Write the filter of an empty set of keys to path: one segment in one
+// shard, all fingerprints 0.
+template <typename FingerprintType, typename HashFamily>
+Status writeEmptyFile(const char* path, uint64_t seed) {
+    HashFamily hasher(deriveSeed(seed, 0));
+    std::vector<FingerprintType> fingerprints(3 * segmentLength);
+    xor_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.kind = XOR_FILE_KIND_FUSE;
+    header.fingerprintBits = 8 * sizeof(FingerprintType);
+    header.hasherBytes = sizeof(HashFamily);
+    header.size = 0;
+    header.arrayLength = fingerprints.size();
+    header.blockLength = segmentLength;
+    header.segmentCount = 1;
+    header.shards = 1;
+    memcpy(header.hasher, &hasher, sizeof(HashFamily));
+    if (!xor_file_write(path, &header, fingerprints.data(),
+                        fingerprints.size() * sizeof(FingerprintType))) {
+        unlink(path);
+        return IOError;
+    }
+    return Ok;
+}
+
+// Build a filter from a file of 64-bit keys (in the byte order of the
+// machine) and write it to path, using about memoryBudget bytes of memory
+// (not counting the page cache). The temporary files, about 8 bytes per
+// key, are created in tmpDir. Returns NotEnoughSpace if the budget is too
+// small for the smallest shards, or if the keys contain duplicates, and
+// IOError if a file could not be read or written.
+template <typename FingerprintType,
+          typename HashFamily = TwoIndependentMultiplyShift>
+Status BuildFile(const char* keysPath, const char* path, size_t memoryBudget,
+                 const char* tmpDir = "/tmp", uint64_t seed = randomSeed()) {
+    static_assert(std::is_trivially_copyable<HashFamily>::value &&
+                  sizeof(HashFamily) <= XOR_FILE_HASHER_SIZE,
+                  "the hash function state must fit in the file header");
+    int keysFd = open(keysPath, O_RDONLY);
+    if (keysFd < 0) {
+        return IOError;
+    }
+    struct stat st;
+    if (fstat(keysFd, &st) != 0 || st.st_size % sizeof(uint64_t) != 0) {
+        close(keysFd);
+        return IOError;
+    }
+    const size_t size = st.st_size / sizeof(uint64_t);
+    if (size == 0) {
+        close(keysFd);
+        return writeEmptyFile<FingerprintType, HashFamily>(path, seed);
+    }
+
+    // the fewest shards whose keys can be peeled within the budget
+    size_t shards = 1;
+    while (true) {
+        Layout layout(size, shards);
+        if (peelBytes<FingerprintType>(maxShardKeys(size, layout.shards),
+                                       layout.ShardLength()) <= memoryBudget) {
+            break;
+        }
+        if (layout.shards < shards) {
+            // the shards can not be made smaller
+            close(keysFd);
+            return NotEnoughSpace;
+        }
+        shards = layout.shards + 1 + layout.shards / 8;
+    }
+    const Layout layout(size, shards);
+    shards = layout.shards;
+    const size_t shardLength = layout.ShardLength();
+    size_t bufferBytes = externalMaxBufferBytes;
+    if (externalReadBytes + shards * bufferBytes > memoryBudget) {
+        bufferBytes = memoryBudget > externalReadBytes
+            ? (memoryBudget - externalReadBytes) / shards / 64 * 64 : 0;
+        if (bufferBytes < externalMinBufferBytes) {
+            close(keysFd);
+            return NotEnoughSpace;
+        }
+    }
+    const size_t bufferKeys = bufferBytes / sizeof(uint64_t);
+
+    ShardFiles shardFiles;
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0 || !shardFiles.Create(tmpDir, shards)) {
+        if (out >= 0) {
+            close(out);
+        }
+        close(keysFd);
+        return IOError;
+    }
+    std::vector<size_t> shardCounts(shards);
+    Status result = NotEnoughSpace;
+    for (int hashIndex = 0; hashIndex < externalMaxAttempts && result == NotEnoughSpace;
+         hashIndex++) {
+        HashFamily hasher(deriveSeed(seed, hashIndex));
+        result = Ok;
+
+        // spill the hashes, grouped by shard, keeping the order of the keys
+        {
+            std::vector<uint64_t> keys(externalReadBytes / sizeof(uint64_t));
+            std::vector<uint64_t> buffers(shards * bufferKeys);
+            std::vector<size_t> fill(shards);
+            std::fill(shardCounts.begin(), shardCounts.end(), 0);
+            for (size_t start = 0; start < size && result == Ok; start += keys.size()) {
+                size_t len = std::min(keys.size(), size - start);
+                if (!preadFully(keysFd, keys.data(), len * sizeof(uint64_t),
+                                start * sizeof(uint64_t))) {
+                    result = IOError;
+                    break;
+                }
+                for (size_t i = 0; i < len; i++) {
+                    uint64_t hash = hasher(keys[i]);
+                    size_t s = layout.ShardOf(hash);
+                    uint64_t* buffer = &buffers[s * bufferKeys];
+                    buffer[fill[s]++] = hash;
+                    if (fill[s] == bufferKeys) {
+                        if (!pwriteFully(shardFiles[s], buffer, bufferBytes,
+                                         shardCounts[s] * sizeof(uint64_t))) {
+                            result = IOError;
+                            break;
+                        }
+                        shardCounts[s] += fill[s];
+                        fill[s] = 0;
+                    }
+                }
+            }
+            for (size_t s = 0; s < shards && result == Ok; s++) {
+                if (!pwriteFully(shardFiles[s], &buffers[s * bufferKeys],
+                                 fill[s] * sizeof(uint64_t),
+                                 shardCounts[s] * sizeof(uint64_t))) {
+                    result = IOError;
+                }
+                shardCounts[s] += fill[s];
+            }
+        }
+        if (result != Ok) {
+            break;
+        }
+
+        xor_file_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.kind = XOR_FILE_KIND_FUSE;
+        header.fingerprintBits = 8 * sizeof(FingerprintType);
+        header.hasherBytes = sizeof(HashFamily);
+        header.size = size;
+        header.arrayLength = layout.arrayLength;
+        header.blockLength = segmentLength;
+        header.segmentCount = layout.segmentCount;
+        header.shards = shards;
+        memcpy(header.hasher, &hasher, sizeof(HashFamily));
+        uint64_t checksum = xor_file_prepare(
+            &header, layout.arrayLength * sizeof(FingerprintType));
+
+        // peel the shards in order, appending their entries to the filter
+        size_t maxCount = *std::max_element(shardCounts.begin(), shardCounts.end());
+        std::vector<uint64_t> hashes(maxCount);
+        std::vector<uint64_t> reverseOrder(maxCount);
+        std::vector<uint8_t> reverseH(maxCount);
+        std::vector<t2val_t> t2vals(shardLength);
+        std::vector<int> alone(shardLength);
+        std::vector<FingerprintType> fingerprints(shardLength);
+        for (size_t s = 0; s < shards; s++) {
+            size_t count = shardCounts[s];
+            if (!preadFully(shardFiles[s], hashes.data(), count * sizeof(uint64_t), 0)) {
+                result = IOError;
+                break;
+            }
+            std::fill(fingerprints.begin(), fingerprints.end(), 0);
+            if (!peelShard(layout, s, hashes.data(), count, t2vals.data(),
+                           alone.data(), reverseOrder.data(), reverseH.data(),
+                           fingerprints.data())) {
+                result = NotEnoughSpace;
+                break;
+            }
+            size_t bytes = shardLength * sizeof(FingerprintType);
+            checksum = xor_file_checksum_update(checksum, fingerprints.data(), bytes);
+            if (!pwriteFully(out, fingerprints.data(), bytes,
+                             XOR_FILE_HEADER_SIZE + s * bytes)) {
+                result = IOError;
+                break;
+            }
+        }
+        if (result == Ok) {
+            header.checksum = checksum;
+            if (!pwriteFully(out, &header, XOR_FILE_HEADER_SIZE, 0)) {
+                result = IOError;
+            }
+        } else if (result == NotEnoughSpace) {
+            std::cout << "WARNING: hashIndex " << hashIndex << "\n";
+            std::cout << size << " keys; arrayLength " << layout.arrayLength
+                << " shards " << shards << "\n";
+        }
+    }
+    close(keysFd);
+    if (close(out) != 0 && result == Ok) {
+        result = IOError;
+    }
+    if (result != Ok) {
+        unlink(path);
+    }
+    return result;
+}
+
+}  // namespace xorfusefilter
+
+#endif  // XOR_EXTERNAL_H_
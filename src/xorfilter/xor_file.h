@@ -0,0 +1,142 @@
+#ifndef XOR_FILE_H_
+#define XOR_FILE_H_
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * On-disk format of xor and xor fuse filters: a 128-byte header, followed by
+ * the fingerprint array exactly as it is in memory. A file can be mapped
+ * with mmap and queried in place, so that many processes can share the
+ * same page-cached copy. Integers are stored in the byte order of the
+ * machine (little endian on x64).
+ */
+#define XOR_FILE_MAGIC "XORFILT"
+#define XOR_FILE_VERSION 1
+#define XOR_FILE_HEADER_SIZE 128
+#define XOR_FILE_HASHER_SIZE 48
+
+// the kind of filter stored in a file
+#define XOR_FILE_KIND_XOR 1
+#define XOR_FILE_KIND_FUSE 2
+
+typedef struct xor_file_header_s {
+  char magic[8];            // XOR_FILE_MAGIC
+  uint32_t version;         // XOR_FILE_VERSION
+  uint32_t kind;            // XOR_FILE_KIND_XOR or XOR_FILE_KIND_FUSE
+  uint32_t fingerprintBits; // 8, 16,...
+  uint32_t hasherBytes;     // size of the hash function state
+  uint64_t size;            // number of keys
+  uint64_t arrayLength;     // number of fingerprints
+  uint64_t blockLength;     // xor: block length; fuse: segment length
+  uint64_t segmentCount;    // fuse only
+  uint64_t shards;          // fuse only
+  // state of the hash function (the seed), 16-byte aligned
+  uint8_t hasher[XOR_FILE_HASHER_SIZE];
+  uint64_t checksum;        // of the header (without checksum) and the data
+  uint64_t dataBytes;       // size of the data after the header
+} xor_file_header_t;
+
+static inline uint64_t xor_file_checksum_update(uint64_t h, const void *data,
+                                                size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, p + i, sizeof(w));
+    h = (h ^ w) * UINT64_C(0x9E3779B97F4A7C15);
+    h ^= h >> 29;
+  }
+  for (; i < len; i++) {
+    h = (h ^ p[i]) * UINT64_C(0x9E3779B97F4A7C15);
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+// checksum of the header (up to the checksum field) and the data
+static inline uint64_t xor_file_checksum(const xor_file_header_t *header,
+                                         const void *data) {
+  uint64_t h = xor_file_checksum_update(
+      0, header, offsetof(xor_file_header_t, checksum));
+  return xor_file_checksum_update(h, data, header->dataBytes);
+}
+
+// Check that the buffer holds a valid filter of the given kind and
+// fingerprint width. The checksum is only verified if verify is true, as
+// this reads the whole file.
+static inline bool xor_file_check(const void *buffer, size_t len, uint32_t kind,
+                                  uint32_t fingerprintBits, bool verify) {
+  const xor_file_header_t *header = (const xor_file_header_t *)buffer;
+  if (len < XOR_FILE_HEADER_SIZE ||
+      memcmp(header->magic, XOR_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != XOR_FILE_VERSION || header->kind != kind ||
+      header->fingerprintBits != fingerprintBits ||
+      header->dataBytes != len - XOR_FILE_HEADER_SIZE) {
+    return false;
+  }
+  return !verify ||
+         header->checksum ==
+             xor_file_checksum(header, (const char *)buffer + XOR_FILE_HEADER_SIZE);
+}
+
+// Set the magic, version and data size. Returns the checksum of the
+// header; to write the data piece by piece, update it with
+// xor_file_checksum_update for each piece (all but the last a multiple of
+// 8 bytes), in order, and store the result in the checksum field.
+static inline uint64_t xor_file_prepare(xor_file_header_t *header,
+                                        size_t dataBytes) {
+  memcpy(header->magic, XOR_FILE_MAGIC, sizeof(header->magic));
+  header->version = XOR_FILE_VERSION;
+  header->dataBytes = dataBytes;
+  return xor_file_checksum_update(0, header,
+                                  offsetof(xor_file_header_t, checksum));
+}
+
+// Set the magic, version, data size and checksum, and write the header and
+// the data to a file. Returns false on failure.
+static inline bool xor_file_write(const char *path, xor_file_header_t *header,
+                                  const void *data, size_t dataBytes) {
+  header->checksum = xor_file_checksum_update(
+      xor_file_prepare(header, dataBytes), data, dataBytes);
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = fwrite(header, XOR_FILE_HEADER_SIZE, 1, file) == 1 &&
+            (dataBytes == 0 || fwrite(data, dataBytes, 1, file) == 1);
+  return fclose(file) == 0 && ok;
+}
+
+// Map a file read-only. Returns NULL on failure; otherwise, the caller is
+// responsible for calling xor_file_unmap.
+static inline const void *xor_file_map(const char *path, size_t *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  void *result = NULL;
+  if (fstat(fd, &st) == 0 && st.st_size >= XOR_FILE_HEADER_SIZE) {
+    *len = (size_t)st.st_size;
+    result = mmap(NULL, *len, PROT_READ, MAP_SHARED, fd, 0);
+    if (result == MAP_FAILED) {
+      result = NULL;
+    }
+  }
+  close(fd);
+  return result;
+}
+
+static inline void xor_file_unmap(const void *buffer, size_t len) {
+  munmap((void *)buffer, len);
+}
+
+#endif // XOR_FILE_H_
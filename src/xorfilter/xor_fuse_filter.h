@@ -2,8 +2,19 @@
 #define XOR_FUSE_FILTER_XOR_FILTER_H_
 
 #include <assert.h>
+#include <limits.h>
 #include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "allocation.h"
 #include "hashutil.h"
+#include "xor_file.h"
+#include "xor_parallel.h"
+#include "xor_radix.h"
+#include "xor_scratch.h"
 
 using namespace std;
 using namespace hashing;
@@ -15,6 +26,7 @@ enum Status {
   NotFound = 1,
   NotEnoughSpace = 2,
   NotSupported = 3,
+  IOError = 4,
 };
 
 inline uint64_t rotl64(uint64_t n, unsigned int c) {
@@ -34,20 +46,71 @@ inline uint32_t reduce(uint32_t hash, uint32_t n) {
 #define H128
 const size_t segmentLengthBits = 13;
 const size_t segmentLength = 1 << segmentLengthBits;
+// each shard needs enough segments to be built reliably
+const size_t minSegmentsPerShard = 64;
+
+// The segments can be split into shards, each with its own two trailing
+// segments, so that the shards can be built independently.
+// shardMul is 2^64 / segmentsPerShard + 1, so that the shard is the high 64
+// bits of seg * shardMul (see Lemire et al., "Faster Remainder by Direct
+// Computation"). With one shard, the result is always 0.
+inline uint64_t getShard(uint64_t seg, uint64_t shardMul) {
+    return (uint64_t) (((__uint128_t) seg * shardMul) >> 64);
+}
 
-size_t getHashFromHash(uint64_t hash, int index, int segmentCount) {
+size_t getHashFromHash(uint64_t hash, int index, int segmentCount, uint64_t shardMul) {
 #ifdef H128
     __uint128_t x = (__uint128_t) hash * (__uint128_t) segmentCount;
-    int seg = (uint64_t)(x >> 64);
+    uint64_t seg = (uint64_t)(x >> 64);
     uint64_t hh = hash;
 #else
     uint64_t seg = reduce(hash, segmentCount);
     uint64_t hh = (hash ^ (hash >> 32));
 #endif
-    int h = (seg + index) * segmentLength + (size_t)((hh >> (index * segmentLengthBits)) & (segmentLength - 1));
+    seg += 2 * getShard(seg, shardMul);
+    size_t h = (seg + index) * segmentLength + (size_t)((hh >> (index * segmentLengthBits)) & (segmentLength - 1));
     return h;
 }
 
+// The segments and shards of a table for the given number of keys. The
+// number of shards is reduced if the table is too small.
+struct Layout {
+  size_t segmentCount;
+  size_t shards;
+  size_t segmentsPerShard;
+  uint64_t shardMul;
+  size_t arrayLength;
+
+  Layout(const size_t size, size_t shards) {
+    size_t capacity = size / 0.879;
+    capacity = (capacity + 3 - 1) / 3 * 3;
+    capacity = (capacity + segmentLength - 1) / segmentLength * segmentLength;
+    // at least one segment, also for an empty set
+    size_t segmentCount = std::max(capacity / segmentLength, (size_t) 1);
+    shards = std::min(shards, segmentCount / minSegmentsPerShard);
+    this->shards = shards < 1 ? 1 : shards;
+    this->segmentsPerShard = (segmentCount + this->shards - 1) / this->shards;
+    this->segmentCount = this->shards * segmentsPerShard;
+    this->shardMul = UINT64_C(0xFFFFFFFFFFFFFFFF) / segmentsPerShard + 1;
+    this->arrayLength = (this->segmentCount + 2 * this->shards) * segmentLength;
+  }
+
+  // number of entries of each shard, including its two trailing segments
+  size_t ShardLength() const { return (segmentsPerShard + 2) * segmentLength; }
+
+  // the shard of a key
+  size_t ShardOf(uint64_t hash) const {
+    return getHashFromHash(hash, 0, segmentCount, shardMul) / ShardLength();
+  }
+};
+
+struct t2val {
+  uint64_t t2;
+  uint64_t t2count;
+};
+
+typedef struct t2val t2val_t;
+
 template <typename ItemType, typename FingerprintType,
           typename HashFamily = TwoIndependentMultiplyShift>
 class XorFuseFilter {
@@ -56,29 +119,93 @@ class XorFuseFilter {
   size_t size;
   size_t arrayLength;
   size_t segmentCount;
+  size_t shards;
+  size_t segmentsPerShard;
+  uint64_t shardMul;
   FingerprintType *fingerprints;
+  allocation::Block memory;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  // the file the fingerprints are mapped from, if any
+  const void* mapping;
+  size_t mappingBytes;
 
   inline FingerprintType fingerprint(const uint64_t hash) const {
     return (FingerprintType) hash;
     // return (FingerprintType) hash ^ (hash >> 32);
   }
 
-  explicit XorFuseFilter(const size_t size) {
-    hasher = new HashFamily();
+  // With more than one shard, AddAll can build the shards in parallel.
+  // The number of shards is reduced if the filter is too small.
+  explicit XorFuseFilter(const size_t size, size_t shards = 1, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
-    size_t capacity = size / 0.879;
-    capacity = (capacity + 3 - 1) / 3 * 3;
-    capacity = (capacity + segmentLength - 1) / segmentLength * segmentLength;
-    this->segmentCount = capacity / segmentLength;
-    this->arrayLength = (segmentCount + 2) * segmentLength;
-    fingerprints = new FingerprintType[arrayLength]();
-    std::fill_n(fingerprints, arrayLength, 0);
+    Layout layout(size, shards);
+    this->shards = layout.shards;
+    this->segmentsPerShard = layout.segmentsPerShard;
+    this->segmentCount = layout.segmentCount;
+    this->shardMul = layout.shardMul;
+    this->arrayLength = layout.arrayLength;
+    memory = allocation::allocate(arrayLength * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
+    mapping = nullptr;
+    mappingBytes = 0;
+  }
+
+  // Map a filter written by Save. The fingerprints are not copied: the
+  // filter is read-only, and AddAll must not be called. If verify is false,
+  // the checksum is not checked, so that only the pages that are queried
+  // are read. Throws std::runtime_error if the file is missing or invalid.
+  explicit XorFuseFilter(const char* path, bool verify = true);
+
+  // Copy the filter, including its table. The copy is never mapped.
+  XorFuseFilter(const XorFuseFilter &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    size = o.size;
+    arrayLength = o.arrayLength;
+    segmentCount = o.segmentCount;
+    shards = o.shards;
+    segmentsPerShard = o.segmentsPerShard;
+    shardMul = o.shardMul;
+    memory = allocation::allocate(arrayLength * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
+    memcpy(fingerprints, o.fingerprints, arrayLength * sizeof(FingerprintType));
+    mapping = nullptr;
+    mappingBytes = 0;
+  }
+
+  // Take over the table (or the mapping) of another filter, which is left
+  // without one.
+  XorFuseFilter(XorFuseFilter &&o) {
+    seed = o.seed;
+    hasher = o.hasher;
+    size = o.size;
+    arrayLength = o.arrayLength;
+    segmentCount = o.segmentCount;
+    shards = o.shards;
+    segmentsPerShard = o.segmentsPerShard;
+    shardMul = o.shardMul;
+    memory = o.memory;
+    fingerprints = o.fingerprints;
+    mapping = o.mapping;
+    mappingBytes = o.mappingBytes;
+    o.hasher = nullptr;
+    o.memory.data = nullptr;
+    o.fingerprints = nullptr;
+    o.mapping = nullptr;
   }
 
   ~XorFuseFilter() {
-    delete[] fingerprints;
+    if (mapping != nullptr) {
+      xor_file_unmap(mapping, mappingBytes);
+    } else {
+      allocation::deallocate(memory);
+    }
     delete hasher;
   }
 
@@ -86,11 +213,46 @@ class XorFuseFilter {
       return AddAll(data.data(),start,end);
   }
 
-  Status AddAll(const ItemType* data, const size_t start, const size_t end);
+  Status AddAll(const ItemType* data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAll(data, start, end, scratch);
+  }
+
+  // Same as AddAll, but the temporary buffers are taken from (and kept in)
+  // the given scratch memory, so that they can be reused by the next build.
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                xorscratch::Scratch &scratch);
+
+  // Same as AddAll, but the hashes are first sorted by segment, so that
+  // counting and peeling access the table almost sequentially. This is
+  // much faster once the table no longer fits in the cache, but uses 16
+  // more bytes per key of temporary memory.
+  Status AddAllSorted(const ItemType* data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAllSorted(data, start, end, scratch);
+  }
+
+  Status AddAllSorted(const ItemType* data, const size_t start, const size_t end,
+                      xorscratch::Scratch &scratch);
+
+  // Same as AddAll, but the shards are built concurrently using up to the
+  // given number of threads. With more than one thread and shard, the
+  // resulting filter does not depend on the number of threads; it may
+  // differ from the one built by AddAll, which peels the keys of a shard
+  // in another order.
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                const size_t threads);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
+  // Write the filter to a file, in the format of xor_file.h.
+  Status Save(const char* path) const;
+
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
@@ -100,14 +262,15 @@ class XorFuseFilter {
 
   // size of the filter in bytes.
   size_t SizeInBytes() const { return arrayLength * sizeof(FingerprintType); }
-};
 
-struct t2val {
-  uint64_t t2;
-  uint64_t t2count;
-};
+  // the memory of the table (empty if the filter is mapped)
+  const allocation::Block &Memory() const { return memory; }
 
-typedef struct t2val t2val_t;
+ private:
+  bool AddShard(size_t shard, const uint64_t* hashes, size_t count,
+                t2val_t* t2vals, int* alone, uint64_t* reverseOrder,
+                uint8_t* reverseH);
+};
 
 const int blockShift = 18;
 
@@ -140,24 +303,27 @@ int applyBlock2(uint64_t* tmp, int b, int len, t2val_t * t2vals, int* alone, int
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
-    const ItemType* keys, const size_t start, const size_t end) {
+    const ItemType* keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch) {
 
     int m = arrayLength;
-    uint64_t* reverseOrder = new uint64_t[size];
-    uint8_t* reverseH = new uint8_t[size];
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, size);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, size);
     size_t reverseOrderPos;
     int hashIndex = 0;
-    t2val_t * t2vals = new t2val_t[m];
+    t2val_t * t2vals = scratch.get<t2val_t>(xorscratch::T2Vals, m);
+    int blocks = 1 + (arrayLength >> blockShift);
+    uint64_t* tmp = scratch.get<uint64_t>(xorscratch::Tmp, blocks << blockShift);
+    int* tmpc = scratch.get<int>(xorscratch::TmpCount, blocks);
+    int* alone = scratch.get<int>(xorscratch::Alone, arrayLength);
     while (true) {
         memset(t2vals, 0, sizeof(t2val_t[m]));
-        int blocks = 1 + (arrayLength >> blockShift);
-        uint64_t* tmp = new uint64_t[blocks << blockShift];
-        int* tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         for(size_t i = start; i < end; i++) {
             uint64_t k = keys[i];
             uint64_t hash = (*hasher)(k);
             for (int hi = 0; hi < 3; hi++) {
-                int index = getHashFromHash(hash, hi, segmentCount);
+                int index = getHashFromHash(hash, hi, segmentCount, shardMul);
                 int b = index >> blockShift;
                 int i2 = tmpc[b];
                 tmp[(b << blockShift) + i2] = hash;
@@ -173,19 +339,15 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
         for (int b = 0; b < blocks; b++) {
             applyBlock(tmp, b, tmpc[b], t2vals);
         }
-        delete[] tmp;
-        delete[] tmpc;
         reverseOrderPos = 0;
 
-        int* alone = new int[arrayLength];
         int alonePos = 0;
         for (size_t i = 0; i < arrayLength; i++) {
             if (t2vals[i].t2count == 1) {
                 alone[alonePos++] = i;
             }
         }
-        tmp = new uint64_t[blocks << blockShift];
-        tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         reverseOrderPos = 0;
         int bestBlock = -1;
         while (reverseOrderPos < size) {
@@ -238,7 +400,7 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
             }
             long hash = t2vals[i].t2;
             for (int hi = 0; hi < 3; hi++) {
-                int h = getHashFromHash(hash, hi, segmentCount);
+                int h = getHashFromHash(hash, hi, segmentCount, shardMul);
                 if (h == i) {
                     found = (uint8_t) hi;
                     t2vals[i].t2count = 0;
@@ -258,9 +420,6 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
             reverseH[reverseOrderPos] = found;
             reverseOrderPos++;
         }
-        delete[] tmp;
-        delete[] tmpc;
-        delete[] alone;
 
         if (reverseOrderPos == size) {
             break;
@@ -276,7 +435,7 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
@@ -290,7 +449,7 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
         // unless the other two entries are already occupied
         FingerprintType xor2 = fingerprint(hash);
         for (int hi = 0; hi < 3; hi++) {
-            size_t h = getHashFromHash(hash, hi, segmentCount);
+            size_t h = getHashFromHash(hash, hi, segmentCount, shardMul);
             if (found == hi) {
                 change = h;
             } else {
@@ -301,9 +460,241 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
         }
         fingerprints[change] = xor2;
     }
+
+    return Ok;
+}
+
+// Peel and assign the keys of one shard of a table with the given layout
+// (a Layout or a filter). t2vals, alone and fingerprints point to the first
+// entry of the shard, so the shards can use disjoint ranges of the same
+// arrays, or arrays that only hold one shard.
+template <typename FingerprintType, typename Table>
+bool peelShard(const Table &layout, size_t shard, const uint64_t* hashes,
+               size_t count, t2val_t* t2vals, int* alone,
+               uint64_t* reverseOrder, uint8_t* reverseH,
+               FingerprintType* fingerprints) {
+    const size_t segmentCount = layout.segmentCount;
+    const uint64_t shardMul = layout.shardMul;
+    size_t shardLength = (layout.segmentsPerShard + 2) * segmentLength;
+    size_t first = shard * shardLength;
+    memset(t2vals, 0, sizeof(t2val_t) * shardLength);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t hash = hashes[i];
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, segmentCount, shardMul) - first;
+            t2vals[h].t2count++;
+            t2vals[h].t2 ^= hash;
+        }
+    }
+    int alonePos = 0;
+    for (size_t i = 0; i < shardLength; i++) {
+        if (t2vals[i].t2count == 1) {
+            alone[alonePos++] = i;
+        }
+    }
+    size_t reverseOrderPos = 0;
+    while (alonePos > 0) {
+        size_t i = alone[--alonePos];
+        if (t2vals[i].t2count == 0) {
+            continue;
+        }
+        uint64_t hash = t2vals[i].t2;
+        uint8_t found = -1;
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, segmentCount, shardMul) - first;
+            if (h == i) {
+                found = (uint8_t) hi;
+                t2vals[i].t2count = 0;
+            } else {
+                if (--t2vals[h].t2count == 1) {
+                    alone[alonePos++] = h;
+                }
+                t2vals[h].t2 ^= hash;
+            }
+        }
+        reverseOrder[reverseOrderPos] = hash;
+        reverseH[reverseOrderPos] = found;
+        reverseOrderPos++;
+    }
+    if (reverseOrderPos != count) {
+        return false;
+    }
+    // entries written by an earlier, failed attempt are harmless: the
+    // entry a key changes is never read by keys assigned before it
+    for (size_t i = reverseOrderPos; i-- > 0;) {
+        uint64_t hash = reverseOrder[i];
+        int found = reverseH[i];
+        size_t change = 0;
+        // the fingerprint, as in XorFuseFilter::fingerprint
+        FingerprintType xor2 = (FingerprintType) hash;
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, segmentCount, shardMul) - first;
+            if (found == hi) {
+                change = h;
+            } else {
+                xor2 ^= fingerprints[h];
+            }
+        }
+        fingerprints[change] = xor2;
+    }
+    return true;
+}
+
+// peel and assign the keys of one shard; the shards use disjoint ranges of
+// all arrays
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+bool XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddShard(
+    size_t shard, const uint64_t* hashes, size_t count, t2val_t* t2vals,
+    int* alone, uint64_t* reverseOrder, uint8_t* reverseH) {
+    size_t first = shard * (segmentsPerShard + 2) * segmentLength;
+    return peelShard(*this, shard, hashes, count, t2vals + first, alone + first,
+                     reverseOrder, reverseH, fingerprints + first);
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAllSorted(
+    const ItemType* keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch) {
+    const size_t n = end - start;
+    uint64_t* hashes = scratch.get<uint64_t>(xorscratch::Hashes, n);
+    uint64_t* tmp = scratch.get<uint64_t>(xorscratch::Tmp, n);
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, n);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, n);
+    t2val_t * t2vals = scratch.get<t2val_t>(xorscratch::T2Vals, arrayLength);
+    int* alone = scratch.get<int>(xorscratch::Alone, arrayLength);
+    std::vector<size_t> shardStart(shards + 1);
+    const size_t shardLength = (segmentsPerShard + 2) * segmentLength;
+    int hashIndex = 0;
+    while (true) {
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = (*hasher)(keys[start + i]);
+        }
+        uint64_t* sorted = xorradix::sortByHighBits(hashes, tmp, n,
+                                                    xorradix::bitsFor(segmentCount));
+        shardStart[0] = 0;
+        shardStart[shards] = n;
+        if (shards > 1) {
+            // the shard boundaries are not aligned with the sorted bits, so
+            // group the hashes by shard (keeping them almost sorted)
+            uint64_t* grouped = sorted == hashes ? tmp : hashes;
+            std::fill(shardStart.begin(), shardStart.end(), 0);
+            for (size_t i = 0; i < n; i++) {
+                shardStart[getHashFromHash(sorted[i], 0, segmentCount, shardMul) / shardLength + 1]++;
+            }
+            for (size_t s = 0; s < shards; s++) {
+                shardStart[s + 1] += shardStart[s];
+            }
+            std::vector<size_t> pos(shardStart.begin(), shardStart.end() - 1);
+            for (size_t i = 0; i < n; i++) {
+                size_t s = getHashFromHash(sorted[i], 0, segmentCount, shardMul) / shardLength;
+                grouped[pos[s]++] = sorted[i];
+            }
+            sorted = grouped;
+        }
+        bool failed = false;
+        for (size_t s = 0; s < shards && !failed; s++) {
+            size_t from = shardStart[s];
+            failed = !AddShard(s, sorted + from, shardStart[s + 1] - from, t2vals,
+                               alone, reverseOrder + from, reverseH + from);
+        }
+        if (!failed) {
+            break;
+        }
+
+        std::cout << "WARNING: hashIndex " << hashIndex << "\n";
+        std::cout << (end - start) << " keys; arrayLength " << arrayLength
+            << " shards " << shards << "\n";
+
+        hashIndex++;
+
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+    return Ok;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::AddAll(
+    const ItemType* keys, const size_t start, const size_t end,
+    const size_t threads) {
+    if (threads <= 1 || shards == 1) {
+        return AddAll(keys, start, end);
+    }
+    // the hashes, grouped by shard
+    uint64_t* hashes = new uint64_t[size];
+    uint64_t* reverseOrder = new uint64_t[size];
+    uint8_t* reverseH = new uint8_t[size];
+    t2val_t * t2vals = new t2val_t[arrayLength];
+    int* alone = new int[arrayLength];
+    // shardCounts[t * shards + s]: number of keys of thread t in shard s,
+    // later the position where they are written
+    std::vector<size_t> shardCounts(threads * shards);
+    std::vector<size_t> shardStart(shards + 1);
+    const size_t n = end - start;
+    const size_t shardLength = (segmentsPerShard + 2) * segmentLength;
+    int hashIndex = 0;
+    while (true) {
+        std::fill(shardCounts.begin(), shardCounts.end(), 0);
+        xorparallel::runThreads(threads, [&](size_t t) {
+            size_t* counts = &shardCounts[t * shards];
+            for (size_t i = start + n * t / threads; i < start + n * (t + 1) / threads; i++) {
+                uint64_t hash = (*hasher)(keys[i]);
+                counts[getHashFromHash(hash, 0, segmentCount, shardMul) / shardLength]++;
+            }
+        });
+        size_t pos = 0;
+        for (size_t s = 0; s < shards; s++) {
+            shardStart[s] = pos;
+            for (size_t t = 0; t < threads; t++) {
+                size_t c = shardCounts[t * shards + s];
+                shardCounts[t * shards + s] = pos;
+                pos += c;
+            }
+        }
+        shardStart[shards] = pos;
+        xorparallel::runThreads(threads, [&](size_t t) {
+            size_t* offsets = &shardCounts[t * shards];
+            for (size_t i = start + n * t / threads; i < start + n * (t + 1) / threads; i++) {
+                uint64_t hash = (*hasher)(keys[i]);
+                size_t s = getHashFromHash(hash, 0, segmentCount, shardMul) / shardLength;
+                hashes[offsets[s]++] = hash;
+            }
+        });
+        size_t nextShard = 0;
+        bool failed = false;
+        xorparallel::runThreads(std::min(threads, shards), [&](size_t t) {
+            size_t s;
+            while ((s = __atomic_fetch_add(&nextShard, 1, __ATOMIC_RELAXED)) < shards) {
+                size_t from = shardStart[s];
+                if (!AddShard(s, hashes + from, shardStart[s + 1] - from, t2vals,
+                        alone, reverseOrder + from, reverseH + from)) {
+                    __atomic_store_n(&failed, true, __ATOMIC_RELAXED);
+                }
+            }
+        });
+        if (!failed) {
+            break;
+        }
+
+        std::cout << "WARNING: hashIndex " << hashIndex << "\n";
+        std::cout << (end - start) << " keys; arrayLength " << arrayLength
+            << " shards " << shards << "\n";
+
+        hashIndex++;
+
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+    delete [] alone;
     delete [] t2vals;
     delete [] reverseOrder;
     delete [] reverseH;
+    delete [] hashes;
 
     return Ok;
 }
@@ -316,19 +707,110 @@ Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::Contain(
     FingerprintType f = fingerprint(hash);
 #ifdef H128
     __uint128_t x = (__uint128_t) hash * (__uint128_t) segmentCount;
-    int seg = (uint64_t)(x >> 64);
+    uint64_t seg = (uint64_t)(x >> 64);
     uint64_t hh = hash;
 #else
     uint64_t seg = reduce(hash, segmentCount);
     uint64_t hh = (hash ^ (hash >> 32));
 #endif
-    int h0 = (seg + 0) * segmentLength + (size_t)((hh >> (0 * segmentLengthBits)) & (segmentLength - 1));
-    int h1 = (seg + 1) * segmentLength + (size_t)((hh >> (1 * segmentLengthBits)) & (segmentLength - 1));
-    int h2 = (seg + 2) * segmentLength + (size_t)((hh >> (2 * segmentLengthBits)) & (segmentLength - 1));
+    seg += 2 * getShard(seg, shardMul);
+    size_t h0 = (seg + 0) * segmentLength + (size_t)((hh >> (0 * segmentLengthBits)) & (segmentLength - 1));
+    size_t h1 = (seg + 1) * segmentLength + (size_t)((hh >> (1 * segmentLengthBits)) & (segmentLength - 1));
+    size_t h2 = (seg + 2) * segmentLength + (size_t)((hh >> (2 * segmentLengthBits)) & (segmentLength - 1));
     f ^= fingerprints[h0] ^ fingerprints[h1] ^ fingerprints[h2];
     return f == 0 ? Ok : NotFound;
 }
 
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+void XorFuseFilter<ItemType, FingerprintType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                __builtin_prefetch(fingerprints + getHashFromHash(hash, hi, segmentCount, shardMul));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = fingerprint(hash);
+            for (int hi = 0; hi < 3; hi++) {
+                f ^= fingerprints[getHashFromHash(hash, hi, segmentCount, shardMul)];
+            }
+            out[start + i] = f == 0;
+        }
+    }
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+Status XorFuseFilter<ItemType, FingerprintType, HashFamily>::Save(
+    const char* path) const {
+    static_assert(std::is_trivially_copyable<HashFamily>::value &&
+                  sizeof(HashFamily) <= XOR_FILE_HASHER_SIZE,
+                  "the hash function state must fit in the file header");
+    xor_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.kind = XOR_FILE_KIND_FUSE;
+    header.fingerprintBits = 8 * sizeof(FingerprintType);
+    header.hasherBytes = sizeof(HashFamily);
+    header.size = size;
+    header.arrayLength = arrayLength;
+    header.blockLength = segmentLength;
+    header.segmentCount = segmentCount;
+    header.shards = shards;
+    memcpy(header.hasher, hasher, sizeof(HashFamily));
+    size_t dataBytes = arrayLength * sizeof(FingerprintType);
+    return xor_file_write(path, &header, fingerprints, dataBytes) ? Ok : IOError;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+XorFuseFilter<ItemType, FingerprintType, HashFamily>::XorFuseFilter(
+    const char* path, bool verify) {
+    static_assert(sizeof(xor_file_header_t) == XOR_FILE_HEADER_SIZE,
+                  "unexpected file header size");
+    static_assert(std::is_trivially_copyable<HashFamily>::value &&
+                  sizeof(HashFamily) <= XOR_FILE_HASHER_SIZE,
+                  "the hash function state must fit in the file header");
+    // the table is not allocated, but stays in the mapping
+    memory.data = nullptr;
+    memory.bytes = 0;
+    memory.policy = allocation::Heap;
+    mapping = xor_file_map(path, &mappingBytes);
+    if (mapping == nullptr) {
+        throw ::std::runtime_error("XorFuseFilter: cannot map file");
+    }
+    const xor_file_header_t* header = (const xor_file_header_t*) mapping;
+    if (!xor_file_check(mapping, mappingBytes, XOR_FILE_KIND_FUSE,
+                        8 * sizeof(FingerprintType), verify) ||
+        header->hasherBytes != sizeof(HashFamily) ||
+        header->blockLength != segmentLength ||
+        header->shards == 0 || header->segmentCount == 0 ||
+        header->segmentCount % header->shards != 0 ||
+        header->arrayLength !=
+            (header->segmentCount + 2 * header->shards) * segmentLength ||
+        header->dataBytes != header->arrayLength * sizeof(FingerprintType)) {
+        xor_file_unmap(mapping, mappingBytes);
+        throw ::std::runtime_error("XorFuseFilter: invalid file");
+    }
+    size = header->size;
+    arrayLength = header->arrayLength;
+    segmentCount = header->segmentCount;
+    shards = header->shards;
+    segmentsPerShard = segmentCount / shards;
+    shardMul = UINT64_C(0xFFFFFFFFFFFFFFFF) / segmentsPerShard + 1;
+    // the seed is not stored, only the state of the hash function
+    seed = 0;
+    hasher = new HashFamily(seed);
+    memcpy(hasher, header->hasher, sizeof(HashFamily));
+    fingerprints = (FingerprintType*) ((const char*) mapping + XOR_FILE_HEADER_SIZE);
+}
+
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 std::string XorFuseFilter<ItemType, FingerprintType, HashFamily>::Info() const {
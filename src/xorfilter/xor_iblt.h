@@ -0,0 +1,206 @@
+#ifndef XOR_FILTER_XOR_IBLT_H_
+#define XOR_FILTER_XOR_IBLT_H_
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+#include "hashutil.h"
+#include "xorfilter.h"
+
+using namespace std;
+using namespace hashing;
+
+// Invertible Bloom lookup table (Goodrich and Mitzenmacher, 2011), for set
+// reconciliation: each replica builds a table of its keys, with the same
+// size and seed; one table is subtracted from the other, and decoding the
+// difference lists the keys only in the first set and those only in the
+// second. The table only needs to be a bit larger than the number of
+// differing keys, whatever the size of the sets.
+//
+// A key is added to one entry in each of three blocks, as in a xor filter,
+// and decoding is the same peeling: an entry with a single key is removed
+// from the other two entries of the key, until no such entry is left.
+namespace xorfilter {
+
+template <typename ItemType, typename HashFamily = TwoIndependentMultiplyShift>
+class XorIblt {
+  static_assert(std::is_integral<ItemType>::value && sizeof(ItemType) <= 8,
+                "the keys must be integers of at most 64 bits");
+
+ public:
+  // the keys of an entry: their number (negative after a subtraction) and
+  // the xor of the keys and of their hashes
+  struct cell {
+    int64_t count;
+    uint64_t keySum;
+    uint64_t hashSum;
+  };
+
+  size_t arrayLength;
+  size_t blockLength;
+  cell *cells;
+
+  HashFamily* hasher;
+  uint64_t seed;
+
+  // The number of entries needed to decode a difference of this many keys
+  // in more than 99% of the cases: with 20000 random differences of each
+  // size from 1 to 5000 keys, decoding failed for at most 0.5% of them
+  // (the most around 100 to 1000 keys). On failure, exchange larger tables.
+  static size_t CellsFor(size_t difference) {
+    return 3 * (64 + difference / 2);
+  }
+
+  // A table of the given number of entries (rounded up to a multiple of 3).
+  // Tables are only compatible if they have the same size and seed.
+  explicit XorIblt(const size_t cellCount, uint64_t seed) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
+    this->blockLength = std::max((cellCount + 2) / 3, (size_t) 1);
+    this->arrayLength = 3 * blockLength;
+    cells = new cell[arrayLength]();
+  }
+
+  XorIblt(const XorIblt &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    arrayLength = o.arrayLength;
+    blockLength = o.blockLength;
+    cells = new cell[arrayLength];
+    memcpy(cells, o.cells, arrayLength * sizeof(cell));
+  }
+
+  ~XorIblt() {
+    delete[] cells;
+    delete hasher;
+  }
+
+  void Add(const ItemType &key) { update(key, 1); }
+
+  void Remove(const ItemType &key) { update(key, -1); }
+
+  void AddAll(const vector<ItemType> &keys, const size_t start, const size_t end) {
+    AddAll(keys.data(), start, end);
+  }
+
+  void AddAll(const ItemType* keys, const size_t start, const size_t end) {
+    for (size_t i = start; i < end; i++) {
+      update(keys[i], 1);
+    }
+  }
+
+  // Subtract the other table, so that this table holds the difference of
+  // the sets. Returns NotSupported if the tables are not compatible.
+  Status Subtract(const XorIblt &o);
+
+  // List the keys with a positive count (added; in this set but not in the
+  // subtracted one) and those with a negative count (removed). Returns
+  // NotEnoughSpace if the difference is too large to decode completely;
+  // the keys found so far are listed anyway.
+  Status Decode(vector<ItemType> &added, vector<ItemType> &removed) const;
+
+  // Copy the entries to out (SizeInBytes() bytes), to ship the table to
+  // another replica. Integers are in the byte order of the machine.
+  void Write(uint8_t* out) const { memcpy(out, cells, SizeInBytes()); }
+
+  // Read the entries written by a table of the same size. Returns
+  // NotSupported if the size does not match.
+  Status Read(const uint8_t* in, size_t len) {
+    if (len != SizeInBytes()) {
+      return NotSupported;
+    }
+    memcpy(cells, in, len);
+    return Ok;
+  }
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // size of the table in bytes.
+  size_t SizeInBytes() const { return arrayLength * sizeof(cell); }
+
+ private:
+  XorIblt& operator=(const XorIblt&) = delete;
+
+  inline void update(const ItemType &key, int64_t delta) {
+    uint64_t hash = (*hasher)(key);
+    for (int hi = 0; hi < 3; hi++) {
+      cell& c = cells[getHashFromHash(hash, hi, blockLength)];
+      c.count += delta;
+      c.keySum ^= (uint64_t) key;
+      c.hashSum ^= hash;
+    }
+  }
+
+  // whether the entry holds a single key (added or removed)
+  inline bool pure(const cell &c) const {
+    return (c.count == 1 || c.count == -1) &&
+           (*hasher)((ItemType) c.keySum) == c.hashSum;
+  }
+};
+
+template <typename ItemType, typename HashFamily>
+Status XorIblt<ItemType, HashFamily>::Subtract(const XorIblt &o) {
+  if (o.arrayLength != arrayLength || o.seed != seed) {
+    return NotSupported;
+  }
+  for (size_t i = 0; i < arrayLength; i++) {
+    cells[i].count -= o.cells[i].count;
+    cells[i].keySum ^= o.cells[i].keySum;
+    cells[i].hashSum ^= o.cells[i].hashSum;
+  }
+  return Ok;
+}
+
+template <typename ItemType, typename HashFamily>
+Status XorIblt<ItemType, HashFamily>::Decode(
+    vector<ItemType> &added, vector<ItemType> &removed) const {
+  std::vector<cell> t(cells, cells + arrayLength);
+  std::vector<size_t> alone;
+  for (size_t i = 0; i < arrayLength; i++) {
+    if (pure(t[i])) {
+      alone.push_back(i);
+    }
+  }
+  while (!alone.empty()) {
+    size_t i = alone.back();
+    alone.pop_back();
+    // the entry may have changed since it was found
+    if (!pure(t[i])) {
+      continue;
+    }
+    int64_t count = t[i].count;
+    uint64_t key = t[i].keySum;
+    uint64_t hash = t[i].hashSum;
+    (count > 0 ? added : removed).push_back((ItemType) key);
+    for (int hi = 0; hi < 3; hi++) {
+      size_t h = getHashFromHash(hash, hi, blockLength);
+      t[h].count -= count;
+      t[h].keySum ^= key;
+      t[h].hashSum ^= hash;
+      if (h != i && pure(t[h])) {
+        alone.push_back(h);
+      }
+    }
+  }
+  for (size_t i = 0; i < arrayLength; i++) {
+    if (t[i].count != 0 || t[i].keySum != 0 || t[i].hashSum != 0) {
+      return NotEnoughSpace;
+    }
+  }
+  return Ok;
+}
+
+template <typename ItemType, typename HashFamily>
+std::string XorIblt<ItemType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "XorIblt Status:\n"
+     << "\t\tEntries: " << arrayLength << "\n";
+  return ss.str();
+}
+}  // namespace xorfilter
+#endif  // XOR_FILTER_XOR_IBLT_H_
@@ -0,0 +1,186 @@
+#ifndef XOR_PARALLEL_H_
+#define XOR_PARALLEL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Multithreaded construction helpers shared by the xor filter variants.
+//
+// Counting uses atomic updates on the t2vals array. Peeling runs in
+// synchronous rounds: in each round, every entry that is alone is processed
+// in parallel (first read-only, to decide which entry peels which key, then
+// to remove the peeled keys). Keys peeled in the same round never touch each
+// other's slot, so the assignment can also run in parallel, one round at a
+// time, in reverse order.
+namespace xorparallel {
+
+// below this many items, a round is processed by the calling thread only
+const size_t minItemsPerThread = 1 << 14;
+
+// run fn(t) for t in [0, threads); the calling thread runs t = 0
+template <typename Fn>
+void runThreads(size_t threads, Fn fn) {
+    if (threads <= 1) {
+        fn(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back(fn, t);
+    }
+    fn(0);
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+inline size_t activeThreads(size_t threads, size_t items) {
+    return std::max((size_t) 1, std::min(threads, items / minItemsPerThread));
+}
+
+// reset t2vals, then hash all keys and add them to their three entries
+template <typename ItemType, typename HashFamily, typename T2Val, typename GetHash>
+void countKeys(const ItemType* keys, const size_t start, const size_t end,
+        const HashFamily &hasher, T2Val *t2vals, size_t arrayLength,
+        size_t threads, GetHash getHash) {
+    runThreads(threads, [&](size_t t) {
+        size_t lo = arrayLength * t / threads;
+        size_t hi = arrayLength * (t + 1) / threads;
+        memset(t2vals + lo, 0, sizeof(T2Val) * (hi - lo));
+    });
+    size_t n = end - start;
+    runThreads(threads, [&](size_t t) {
+        size_t first = start + n * t / threads;
+        size_t last = start + n * (t + 1) / threads;
+        for (size_t i = first; i < last; i++) {
+            uint64_t hash = hasher(keys[i]);
+            for (int hi = 0; hi < 3; hi++) {
+                size_t index = getHash(hash, hi);
+                __atomic_fetch_add(&t2vals[index].t2count, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_xor(&t2vals[index].t2, hash, __ATOMIC_RELAXED);
+            }
+        }
+    });
+}
+
+struct peeledKey {
+    uint64_t hash;
+    uint8_t found;
+};
+
+// Peel the hypergraph in rounds. Returns the number of keys peeled; on
+// success, this is the number of keys. roundEnds[r] is the position in
+// reverseOrder where round r ends.
+template <typename T2Val, typename GetHash>
+size_t peel(T2Val *t2vals, size_t arrayLength, uint64_t *reverseOrder,
+        uint8_t *reverseH, std::vector<size_t> &roundEnds, size_t threads,
+        GetHash getHash) {
+    std::vector<std::vector<uint32_t>> alone(threads), nextAlone(threads);
+    std::vector<std::vector<peeledKey>> peeled(threads);
+    runThreads(threads, [&](size_t t) {
+        size_t lo = arrayLength * t / threads;
+        size_t hi = arrayLength * (t + 1) / threads;
+        for (size_t i = lo; i < hi; i++) {
+            if (t2vals[i].t2count == 1) {
+                alone[t].push_back(i);
+            }
+        }
+    });
+    size_t reverseOrderPos = 0;
+    roundEnds.clear();
+    while (true) {
+        size_t total = 0;
+        for (auto &a : alone) {
+            total += a.size();
+        }
+        if (total == 0) {
+            break;
+        }
+        size_t active = activeThreads(threads, total);
+        // phase 1 (read only): a key is peeled by the first of its
+        // entries that is alone
+        runThreads(active, [&](size_t t) {
+            size_t first = total * t / active;
+            size_t last = total * (t + 1) / active;
+            peeled[t].clear();
+            size_t offset = 0;
+            for (auto &a : alone) {
+                size_t from = std::max(first, offset);
+                size_t to = std::min(last, offset + a.size());
+                for (size_t j = from; j < to; j++) {
+                    size_t i = a[j - offset];
+                    if (t2vals[i].t2count != 1) {
+                        continue;
+                    }
+                    uint64_t hash = t2vals[i].t2;
+                    for (int hi = 0; hi < 3; hi++) {
+                        size_t h = getHash(hash, hi);
+                        if (t2vals[h].t2count == 1) {
+                            if (h == i) {
+                                peeled[t].push_back({hash, (uint8_t) hi});
+                            }
+                            break;
+                        }
+                    }
+                }
+                offset += a.size();
+            }
+        });
+        for (auto &a : nextAlone) {
+            a.clear();
+        }
+        // phase 2: remove the peeled keys from their other entries
+        runThreads(active, [&](size_t t) {
+            for (const peeledKey &p : peeled[t]) {
+                for (int hi = 0; hi < 3; hi++) {
+                    size_t h = getHash(p.hash, hi);
+                    if (hi == p.found) {
+                        t2vals[h].t2count = 0;
+                        continue;
+                    }
+                    uint64_t newCount = __atomic_sub_fetch(&t2vals[h].t2count, 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_xor(&t2vals[h].t2, p.hash, __ATOMIC_RELAXED);
+                    if (newCount == 1) {
+                        nextAlone[t].push_back(h);
+                    }
+                }
+            }
+            size_t pos = __atomic_fetch_add(&reverseOrderPos, peeled[t].size(), __ATOMIC_RELAXED);
+            for (const peeledKey &p : peeled[t]) {
+                reverseOrder[pos] = p.hash;
+                reverseH[pos] = p.found;
+                pos++;
+            }
+        });
+        roundEnds.push_back(reverseOrderPos);
+        std::swap(alone, nextAlone);
+    }
+    return reverseOrderPos;
+}
+
+// call fn(hash, found) for each peeled key, last round first
+template <typename Fn>
+void assignByRound(const uint64_t *reverseOrder, const uint8_t *reverseH,
+        const std::vector<size_t> &roundEnds, size_t threads, Fn fn) {
+    for (size_t r = roundEnds.size(); r-- > 0;) {
+        size_t roundStart = r == 0 ? 0 : roundEnds[r - 1];
+        size_t n = roundEnds[r] - roundStart;
+        size_t active = activeThreads(threads, n);
+        runThreads(active, [&](size_t t) {
+            size_t lo = roundStart + n * t / active;
+            size_t hi = roundStart + n * (t + 1) / active;
+            for (size_t i = lo; i < hi; i++) {
+                fn(reverseOrder[i], reverseH[i]);
+            }
+        });
+    }
+}
+
+}  // namespace xorparallel
+
+#endif  // XOR_PARALLEL_H_
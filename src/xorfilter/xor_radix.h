@@ -0,0 +1,82 @@
+#ifndef XOR_RADIX_H_
+#define XOR_RADIX_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Radix sort of 64-bit hashes by their highest bits.
+//
+// In fuse filters, the first segment of a key is the high bits of its hash
+// times the number of segments, so sorting the hashes by their high bits
+// sorts them by segment. Counting and peeling the keys in this order touches
+// the table almost sequentially, instead of with one cache miss per entry.
+namespace xorradix {
+
+// number of bits of each digit
+const int digitBits = 8;
+const int digitCount = 1 << digitBits;
+// values per write-combining buffer (one cache line)
+const int bufferSize = 8;
+
+// the number of high bits that select one of count ranges of equal size
+// (for example, the first segment of a key)
+inline int bitsFor(uint64_t count) {
+    return count <= 1 ? 1 : 64 - __builtin_clzll(count - 1);
+}
+
+// Sort the n values by their highest bits (rounded up to a multiple of 8,
+// at most 64), least significant digit first. tmp must hold n values.
+// Returns the array that holds the sorted values: values or tmp. The sort
+// is stable.
+inline uint64_t* sortByHighBits(uint64_t* values, uint64_t* tmp, size_t n,
+                                int bits) {
+    const int passes = (bits + digitBits - 1) / digitBits;
+    // the histograms of all digits, computed in a single pass
+    size_t counts[8][digitCount];
+    memset(counts, 0, sizeof(counts[0]) * passes);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = values[i];
+        for (int p = 0; p < passes; p++) {
+            counts[p][(v >> (64 - digitBits * (passes - p))) & (digitCount - 1)]++;
+        }
+    }
+    uint64_t* from = values;
+    uint64_t* to = tmp;
+    for (int p = 0; p < passes; p++) {
+        const int shift = 64 - digitBits * (passes - p);
+        size_t sum = 0;
+        for (int d = 0; d < digitCount; d++) {
+            size_t c = counts[p][d];
+            counts[p][d] = sum;
+            sum += c;
+        }
+        // the values are collected in one small buffer per digit, and
+        // written a cache line at a time, which is about twice as fast as
+        // scattering them one by one
+        alignas(64) uint64_t buffers[digitCount][bufferSize];
+        uint32_t fill[digitCount];
+        memset(fill, 0, sizeof(fill));
+        size_t* pos = counts[p];
+        for (size_t i = 0; i < n; i++) {
+            uint64_t v = from[i];
+            int d = (v >> shift) & (digitCount - 1);
+            buffers[d][fill[d]++] = v;
+            if (fill[d] == bufferSize) {
+                memcpy(to + pos[d], buffers[d], sizeof(buffers[d]));
+                pos[d] += bufferSize;
+                fill[d] = 0;
+            }
+        }
+        for (int d = 0; d < digitCount; d++) {
+            memcpy(to + pos[d], buffers[d], fill[d] * sizeof(uint64_t));
+        }
+        uint64_t* t = from;
+        from = to;
+        to = t;
+    }
+    return from;
+}
+
+}  // namespace xorradix
+
+#endif  // XOR_RADIX_H_
@@ -0,0 +1,256 @@
+#ifndef XOR_FILTER_XOR_RETRIEVAL_H_
+#define XOR_FILTER_XOR_RETRIEVAL_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "hashutil.h"
+#include "nbit_array.h"
+#include "xorfilter.h"
+
+using namespace std;
+using namespace hashing;
+
+// Static retrieval data structure (a Bloomier filter): stores a value of
+// valueBits bits for each key of a fixed set, in about 1.23 * valueBits
+// bits per key, without storing the keys. It is built like a xor filter,
+// except that the value of a key, rather than its fingerprint, is the xor
+// of its three entries. Looking up a key of the set returns its value;
+// looking up any other key returns an arbitrary value.
+namespace xorfilter {
+
+// construction fails (with duplicate keys) after this many attempts with
+// different seeds
+const int retrievalMaxAttempts = 100;
+
+template <typename ItemType, int valueBits,
+          typename HashFamily = TwoIndependentMultiplyShift>
+class XorRetrieval {
+  static_assert(valueBits >= 1 && valueBits <= 32,
+                "valueBits must be between 1 and 32");
+
+  // a table entry while peeling: the xor of the hashes and of the values
+  // of its keys, and their number
+  struct cell {
+    uint64_t t2;
+    uint32_t t2count;
+    uint32_t value;
+  };
+
+ public:
+  size_t size;
+  size_t arrayLength;
+  size_t blockLength;
+  PackedBitArray<valueBits> *values;
+
+  HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  explicit XorRetrieval(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
+    this->size = size;
+    this->arrayLength = 32 + 1.23 * size;
+    this->blockLength = arrayLength / 3;
+    values = new PackedBitArray<valueBits>(arrayLength);
+  }
+
+  // Take over the table of another map, which is left without one.
+  XorRetrieval(XorRetrieval &&o)
+      : size(o.size), arrayLength(o.arrayLength), blockLength(o.blockLength),
+        values(o.values), hasher(o.hasher), seed(o.seed) {
+    o.values = nullptr;
+    o.hasher = nullptr;
+  }
+
+  ~XorRetrieval() {
+    delete values;
+    delete hasher;
+  }
+
+  // Store value[i] for keys[i], for i in [start, end). Only the lowest
+  // valueBits bits of the values are kept. Returns NotEnoughSpace if the
+  // keys contain duplicates.
+  Status AddAll(const vector<ItemType> &keys, const vector<uint32_t> &value,
+                const size_t start, const size_t end) {
+      return AddAll(keys.data(), value.data(), start, end);
+  }
+
+  Status AddAll(const ItemType* keys, const uint32_t* value, const size_t start,
+                const size_t end);
+
+  // The value of the key; arbitrary if the key is not in the set.
+  uint32_t Get(const ItemType &key) const;
+
+  // Get for n keys at once (see containBatchSize).
+  void GetBatch(const ItemType* keys, size_t n, uint32_t* out) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return size; }
+
+  // size of the table in bytes.
+  size_t SizeInBytes() const { return values->getByteCount(); }
+
+ private:
+  XorRetrieval(const XorRetrieval&) = delete;
+  XorRetrieval& operator=(const XorRetrieval&) = delete;
+
+  // count and peel the keys; returns the number of keys peeled
+  size_t Peel(const ItemType* keys, const uint32_t* value, const size_t start,
+              const size_t end, cell* cells, uint64_t* reverseOrder,
+              uint32_t* reverseValue, uint8_t* reverseH);
+};
+
+template <typename ItemType, int valueBits, typename HashFamily>
+size_t XorRetrieval<ItemType, valueBits, HashFamily>::Peel(
+    const ItemType* keys, const uint32_t* value, const size_t start,
+    const size_t end, cell* cells, uint64_t* reverseOrder,
+    uint32_t* reverseValue, uint8_t* reverseH) {
+    memset(cells, 0, sizeof(cell) * arrayLength);
+    for (size_t i = start; i < end; i++) {
+        uint64_t hash = (*hasher)(keys[i]);
+        for (int hi = 0; hi < 3; hi++) {
+            cell& c = cells[getHashFromHash(hash, hi, blockLength)];
+            c.t2 ^= hash;
+            c.t2count++;
+            c.value ^= value[i];
+        }
+    }
+    std::vector<size_t> alone;
+    for (size_t i = 0; i < arrayLength; i++) {
+        if (cells[i].t2count == 1) {
+            alone.push_back(i);
+        }
+    }
+    size_t reverseOrderPos = 0;
+    while (!alone.empty()) {
+        size_t i = alone.back();
+        alone.pop_back();
+        if (cells[i].t2count == 0) {
+            continue;
+        }
+        // the only key left in this entry
+        uint64_t hash = cells[i].t2;
+        uint32_t v = cells[i].value;
+        uint8_t found = -1;
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, blockLength);
+            cell& c = cells[h];
+            if (h == i) {
+                found = (uint8_t) hi;
+                c.t2count = 0;
+            } else {
+                if (--c.t2count == 1) {
+                    alone.push_back(h);
+                }
+                c.t2 ^= hash;
+                c.value ^= v;
+            }
+        }
+        reverseOrder[reverseOrderPos] = hash;
+        reverseValue[reverseOrderPos] = v;
+        reverseH[reverseOrderPos] = found;
+        reverseOrderPos++;
+    }
+    return reverseOrderPos;
+}
+
+template <typename ItemType, int valueBits, typename HashFamily>
+Status XorRetrieval<ItemType, valueBits, HashFamily>::AddAll(
+    const ItemType* keys, const uint32_t* value, const size_t start,
+    const size_t end) {
+    uint64_t* reverseOrder = new uint64_t[size];
+    uint32_t* reverseValue = new uint32_t[size];
+    uint8_t* reverseH = new uint8_t[size];
+    cell* cells = new cell[arrayLength];
+    Status result = Ok;
+    for (int hashIndex = 0; ; ) {
+        size_t reverseOrderPos = Peel(keys, value, start, end, cells,
+                                      reverseOrder, reverseValue, reverseH);
+        if (reverseOrderPos == size) {
+            break;
+        }
+        if (++hashIndex == retrievalMaxAttempts) {
+            result = NotEnoughSpace;
+            break;
+        }
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+    delete[] cells;
+    if (result == Ok) {
+        for (size_t i = size; i-- > 0;) {
+            uint64_t hash = reverseOrder[i];
+            int found = reverseH[i];
+            size_t change = 0;
+            // entries of keys peeled later are already set
+            uint32_t v = reverseValue[i];
+            for (int hi = 0; hi < 3; hi++) {
+                size_t h = getHashFromHash(hash, hi, blockLength);
+                if (found == hi) {
+                    change = h;
+                } else {
+                    v ^= values->get(h);
+                }
+            }
+            values->set(change, v);
+        }
+    }
+    delete[] reverseOrder;
+    delete[] reverseValue;
+    delete[] reverseH;
+    return result;
+}
+
+template <typename ItemType, int valueBits, typename HashFamily>
+uint32_t XorRetrieval<ItemType, valueBits, HashFamily>::Get(
+    const ItemType &key) const {
+    uint64_t hash = (*hasher)(key);
+    uint32_t v = 0;
+    for (int hi = 0; hi < 3; hi++) {
+        v ^= values->get(getHashFromHash(hash, hi, blockLength));
+    }
+    return values->mask(v);
+}
+
+template <typename ItemType, int valueBits, typename HashFamily>
+void XorRetrieval<ItemType, valueBits, HashFamily>::GetBatch(
+    const ItemType* keys, size_t n, uint32_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                values->prefetch(getHashFromHash(hash, hi, blockLength));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            uint32_t v = 0;
+            for (int hi = 0; hi < 3; hi++) {
+                v ^= values->get(getHashFromHash(hash, hi, blockLength));
+            }
+            out[start + i] = values->mask(v);
+        }
+    }
+}
+
+template <typename ItemType, int valueBits, typename HashFamily>
+std::string XorRetrieval<ItemType, valueBits, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "XorRetrieval Status:\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tValue bits: " << valueBits << "\n";
+  return ss.str();
+}
+}  // namespace xorfilter
+#endif  // XOR_FILTER_XOR_RETRIEVAL_H_
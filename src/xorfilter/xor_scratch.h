@@ -0,0 +1,87 @@
+#ifndef XOR_SCRATCH_H_
+#define XOR_SCRATCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+
+// Temporary memory used while building xor filters.
+//
+// A Scratch keeps its buffers between builds (and between the retries of a
+// build), so building many filters one after the other with the same
+// Scratch only allocates, and page faults, during the first builds. A
+// Scratch can be shared by filters of different types and sizes, but not by
+// concurrent builds.
+namespace xorscratch {
+
+// the buffers used by the builders
+enum Slot {
+  ReverseOrder = 0,
+  ReverseH,
+  T2Vals,
+  Tmp,
+  TmpCount,
+  Alone,
+  Alone1,
+  Alone2,
+  Hashes,
+  Fingerprints,
+  T2Counts,
+  SlotCount,
+};
+
+class Scratch {
+ public:
+  Scratch() {
+    for (int i = 0; i < SlotCount; i++) {
+      data[i] = nullptr;
+      capacity[i] = 0;
+    }
+  }
+
+  ~Scratch() {
+    for (int i = 0; i < SlotCount; i++) {
+      free(data[i]);
+    }
+  }
+
+  // A buffer of at least n items, aligned to a cache line. The content is
+  // undefined. The buffer remains valid until the next call for the same
+  // slot, or until the Scratch is destroyed.
+  template <typename T>
+  T* get(Slot slot, size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (bytes > capacity[slot]) {
+      free(data[slot]);
+      data[slot] = nullptr;
+      capacity[slot] = 0;
+      if (posix_memalign(&data[slot], 64, bytes) != 0) {
+        data[slot] = nullptr;
+        throw ::std::bad_alloc();
+      }
+      capacity[slot] = bytes;
+    }
+    return (T*) data[slot];
+  }
+
+  // number of bytes held
+  size_t SizeInBytes() const {
+    size_t result = 0;
+    for (int i = 0; i < SlotCount; i++) {
+      result += capacity[i];
+    }
+    return result;
+  }
+
+ private:
+  void* data[SlotCount];
+  size_t capacity[SlotCount];
+
+  Scratch(const Scratch&) = delete;
+  Scratch& operator=(const Scratch&) = delete;
+};
+
+}  // namespace xorscratch
+
+#endif  // XOR_SCRATCH_H_
@@ -0,0 +1,177 @@
+#ifndef XOR_SIMD_H_
+#define XOR_SIMD_H_
+
+#include <stdint.h>
+
+/**
+ * Vectorized lookup of 8 keys at a time, for xor filters with 8-bit or
+ * 16-bit fingerprints, hashed with murmur64(key + seed), and laid out as
+ * three blocks of blockLength entries (xor8_t, xor16_t, and XorFilter with
+ * SimpleMixSplit).
+ *
+ * The hash, the three indexes and the fingerprints are computed in vector
+ * lanes, and the entries are fetched with gather instructions. The kernel
+ * is chosen at runtime: AVX-512 (8 keys per vector), AVX2 (4 keys per
+ * vector), or scalar code.
+ *
+ * The gathers read 32 bits at each entry, so the fingerprint array must
+ * have XOR_SIMD_PADDING extra entries at the end.
+ */
+#define XOR_SIMD_PADDING 3
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define XOR_SIMD_X64
+#include <immintrin.h>
+#endif
+
+static inline uint8_t xor_contain8_scalar(const uint64_t *keys, uint64_t seed,
+                                          uint32_t blockLength,
+                                          const void *fingerprints,
+                                          int fingerprintBytes) {
+  uint8_t result = 0;
+  for (int i = 0; i < 8; i++) {
+    uint64_t h = keys[i] + seed;
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    uint32_t f = (uint32_t)(h ^ (h >> 32));
+    uint32_t r0 = (uint32_t)h;
+    uint32_t r1 = (uint32_t)((h << 21) | (h >> 43));
+    uint32_t r2 = (uint32_t)((h << 42) | (h >> 22));
+    uint32_t h0 = (uint32_t)(((uint64_t)r0 * blockLength) >> 32);
+    uint32_t h1 = (uint32_t)(((uint64_t)r1 * blockLength) >> 32) + blockLength;
+    uint32_t h2 = (uint32_t)(((uint64_t)r2 * blockLength) >> 32) + 2 * blockLength;
+    if (fingerprintBytes == 1) {
+      const uint8_t *fp = (const uint8_t *)fingerprints;
+      f = (uint8_t)(f ^ fp[h0] ^ fp[h1] ^ fp[h2]);
+    } else {
+      const uint16_t *fp = (const uint16_t *)fingerprints;
+      f = (uint16_t)(f ^ fp[h0] ^ fp[h1] ^ fp[h2]);
+    }
+    result |= (uint8_t)((f == 0) << i);
+  }
+  return result;
+}
+
+#ifdef XOR_SIMD_X64
+
+__attribute__((target("avx2")))
+static inline __m256i xor_mullo64_avx2(__m256i a, __m256i b) {
+  // AVX2 has no 64-bit multiply: combine three 32x32->64 products
+  __m256i lo = _mm256_mul_epu32(a, b);
+  __m256i t1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+  __m256i t2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(_mm256_add_epi64(t1, t2), 32));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t xor_contain4_avx2(const uint64_t *keys, uint64_t seed,
+                                         uint32_t blockLength,
+                                         const void *fingerprints,
+                                         int fingerprintBytes) {
+  __m256i h = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)keys),
+                               _mm256_set1_epi64x(seed));
+  h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+  h = xor_mullo64_avx2(h, _mm256_set1_epi64x(UINT64_C(0xff51afd7ed558ccd)));
+  h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+  h = xor_mullo64_avx2(h, _mm256_set1_epi64x(UINT64_C(0xc4ceb9fe1a85ec53)));
+  h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 33));
+  __m256i bl = _mm256_set1_epi64x(blockLength);
+  __m256i r1 = _mm256_or_si256(_mm256_slli_epi64(h, 21), _mm256_srli_epi64(h, 43));
+  __m256i r2 = _mm256_or_si256(_mm256_slli_epi64(h, 42), _mm256_srli_epi64(h, 22));
+  // reduce: the high 32 bits of the low 32 bits of each lane times blockLength
+  __m256i h0 = _mm256_srli_epi64(_mm256_mul_epu32(h, bl), 32);
+  __m256i h1 = _mm256_add_epi64(_mm256_srli_epi64(_mm256_mul_epu32(r1, bl), 32), bl);
+  __m256i h2 = _mm256_add_epi64(_mm256_srli_epi64(_mm256_mul_epu32(r2, bl), 32),
+                                _mm256_add_epi64(bl, bl));
+  const int *base = (const int *)fingerprints;
+  __m128i x, mask;
+  if (fingerprintBytes == 1) {
+    x = _mm256_i64gather_epi32(base, h0, 1);
+    x = _mm_xor_si128(x, _mm256_i64gather_epi32(base, h1, 1));
+    x = _mm_xor_si128(x, _mm256_i64gather_epi32(base, h2, 1));
+    mask = _mm_set1_epi32(0xff);
+  } else {
+    x = _mm256_i64gather_epi32(base, h0, 2);
+    x = _mm_xor_si128(x, _mm256_i64gather_epi32(base, h1, 2));
+    x = _mm_xor_si128(x, _mm256_i64gather_epi32(base, h2, 2));
+    mask = _mm_set1_epi32(0xffff);
+  }
+  // the fingerprint is the low bits of hash ^ (hash >> 32)
+  __m256i f = _mm256_xor_si256(h, _mm256_srli_epi64(h, 32));
+  f = _mm256_permutevar8x32_epi32(f, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+  x = _mm_and_si128(_mm_xor_si128(x, _mm256_castsi256_si128(f)), mask);
+  x = _mm_cmpeq_epi32(x, _mm_setzero_si128());
+  return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(x));
+}
+
+// GCC 12 reports false "uninitialized" warnings in the AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f,avx512dq")))
+static inline uint32_t xor_contain8_avx512(const uint64_t *keys, uint64_t seed,
+                                           uint32_t blockLength,
+                                           const void *fingerprints,
+                                           int fingerprintBytes) {
+  __m512i h = _mm512_add_epi64(_mm512_loadu_si512((const void *)keys),
+                               _mm512_set1_epi64(seed));
+  h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+  h = _mm512_mullo_epi64(h, _mm512_set1_epi64(UINT64_C(0xff51afd7ed558ccd)));
+  h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+  h = _mm512_mullo_epi64(h, _mm512_set1_epi64(UINT64_C(0xc4ceb9fe1a85ec53)));
+  h = _mm512_xor_si512(h, _mm512_srli_epi64(h, 33));
+  __m512i bl = _mm512_set1_epi64(blockLength);
+  __m512i r1 = _mm512_rol_epi64(h, 21);
+  __m512i r2 = _mm512_rol_epi64(h, 42);
+  __m512i h0 = _mm512_srli_epi64(_mm512_mul_epu32(h, bl), 32);
+  __m512i h1 = _mm512_add_epi64(_mm512_srli_epi64(_mm512_mul_epu32(r1, bl), 32), bl);
+  __m512i h2 = _mm512_add_epi64(_mm512_srli_epi64(_mm512_mul_epu32(r2, bl), 32),
+                                _mm512_add_epi64(bl, bl));
+  __m256i x, mask;
+  if (fingerprintBytes == 1) {
+    x = _mm512_i64gather_epi32(h0, fingerprints, 1);
+    x = _mm256_xor_si256(x, _mm512_i64gather_epi32(h1, fingerprints, 1));
+    x = _mm256_xor_si256(x, _mm512_i64gather_epi32(h2, fingerprints, 1));
+    mask = _mm256_set1_epi32(0xff);
+  } else {
+    x = _mm512_i64gather_epi32(h0, fingerprints, 2);
+    x = _mm256_xor_si256(x, _mm512_i64gather_epi32(h1, fingerprints, 2));
+    x = _mm256_xor_si256(x, _mm512_i64gather_epi32(h2, fingerprints, 2));
+    mask = _mm256_set1_epi32(0xffff);
+  }
+  __m256i f = _mm512_cvtepi64_epi32(_mm512_xor_si512(h, _mm512_srli_epi64(h, 32)));
+  x = _mm256_and_si256(_mm256_xor_si256(x, f), mask);
+  x = _mm256_cmpeq_epi32(x, _mm256_setzero_si256());
+  return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(x));
+}
+#pragma GCC diagnostic pop
+
+#endif // XOR_SIMD_X64
+
+// Bit i of the result is set if keys[i] may be in the set.
+// fingerprintBytes is 1 or 2.
+static inline uint8_t xor_contain8(const uint64_t *keys, uint64_t seed,
+                                   uint32_t blockLength,
+                                   const void *fingerprints,
+                                   int fingerprintBytes) {
+#ifdef XOR_SIMD_X64
+  if (__builtin_cpu_supports("avx512dq")) {
+    return (uint8_t)xor_contain8_avx512(keys, seed, blockLength, fingerprints,
+                                        fingerprintBytes);
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return (uint8_t)(xor_contain4_avx2(keys, seed, blockLength, fingerprints,
+                                       fingerprintBytes) |
+                     (xor_contain4_avx2(keys + 4, seed, blockLength,
+                                        fingerprints, fingerprintBytes)
+                      << 4));
+  }
+#endif
+  return xor_contain8_scalar(keys, seed, blockLength, fingerprints,
+                             fingerprintBytes);
+}
+
+#endif // XOR_SIMD_H_
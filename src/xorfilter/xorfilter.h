@@ -2,8 +2,19 @@
 #define XOR_FILTER_XOR_FILTER_H_
 
 #include <assert.h>
+#include <limits.h>
 #include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "allocation.h"
 #include "hashutil.h"
+#include "xor_file.h"
+#include "xor_parallel.h"
+#include "xor_scratch.h"
+#include "xor_simd.h"
 
 using namespace std;
 using namespace hashing;
@@ -15,6 +26,7 @@ enum Status {
   NotFound = 1,
   NotEnoughSpace = 2,
   NotSupported = 3,
+  IOError = 4,
 };
 
 inline uint64_t rotl64(uint64_t n, unsigned int c) {
@@ -45,24 +57,79 @@ class XorFilter {
   size_t arrayLength;
   size_t blockLength;
   FingerprintType *fingerprints;
+  allocation::Block memory;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  // the file the fingerprints are mapped from, if any
+  const void* mapping;
+  size_t mappingBytes;
 
   inline FingerprintType fingerprint(const uint64_t hash) const {
     return (FingerprintType) hash ^ (hash >> 32);
   }
 
-  explicit XorFilter(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
-    fingerprints = new FingerprintType[arrayLength]();
-    std::fill_n(fingerprints, arrayLength, 0);
+    // padding for the gathers in Contain8
+    memory = allocation::allocate(
+        (arrayLength + XOR_SIMD_PADDING) * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
+    mapping = nullptr;
+    mappingBytes = 0;
+  }
+
+  // Map a filter written by Save. The fingerprints are not copied: the
+  // filter is read-only, and AddAll must not be called. If verify is false,
+  // the checksum is not checked, so that only the pages that are queried
+  // are read. Throws std::runtime_error if the file is missing or invalid.
+  explicit XorFilter(const char* path, bool verify = true);
+
+  // Copy the filter, including its table. The copy is never mapped.
+  XorFilter(const XorFilter &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    size = o.size;
+    arrayLength = o.arrayLength;
+    blockLength = o.blockLength;
+    size_t bytes = (arrayLength + XOR_SIMD_PADDING) * sizeof(FingerprintType);
+    memory = allocation::allocate(bytes);
+    fingerprints = (FingerprintType*) memory.data;
+    memcpy(fingerprints, o.fingerprints, bytes);
+    mapping = nullptr;
+    mappingBytes = 0;
+  }
+
+  // Take over the table (or the mapping) of another filter, which is left
+  // without one.
+  XorFilter(XorFilter &&o) {
+    seed = o.seed;
+    hasher = o.hasher;
+    size = o.size;
+    arrayLength = o.arrayLength;
+    blockLength = o.blockLength;
+    memory = o.memory;
+    fingerprints = o.fingerprints;
+    mapping = o.mapping;
+    mappingBytes = o.mappingBytes;
+    o.hasher = nullptr;
+    o.memory.data = nullptr;
+    o.fingerprints = nullptr;
+    o.mapping = nullptr;
   }
 
   ~XorFilter() {
-    delete[] fingerprints;
+    if (mapping != nullptr) {
+      xor_file_unmap(mapping, mappingBytes);
+    } else {
+      allocation::deallocate(memory);
+    }
     delete hasher;
   }
 
@@ -70,11 +137,39 @@ class XorFilter {
       return AddAll(data.data(),start,end);
   }
 
-  Status AddAll(const ItemType* data, const size_t start, const size_t end);
+  Status AddAll(const ItemType* data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAll(data, start, end, scratch);
+  }
+
+  // Same as AddAll, but the temporary buffers are taken from (and kept in)
+  // the given scratch memory, so that they can be reused by the next build.
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                xorscratch::Scratch &scratch);
+
+  // Same as AddAll, but hashing, peeling and assignment use up to the given
+  // number of threads. With more than one thread, the resulting filter only
+  // depends on the keys and the seed, not on the number of threads; it may
+  // differ from the one built by the single-threaded version (also used for
+  // threads <= 1), as keys are peeled in a different order.
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                const size_t threads);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
+  // Report which of the 8 keys may be in the set (bit i for keys[i]).
+  // With 8 or 16 bit fingerprints and SimpleMixSplit, this uses AVX-512 or
+  // AVX2 if the processor supports it.
+  uint8_t Contain8(const ItemType* keys) const;
+
+  // Write the filter to a file, in the format of xor_file.h.
+  Status Save(const char* path) const;
+
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
@@ -84,6 +179,9 @@ class XorFilter {
 
   // size of the filter in bytes.
   size_t SizeInBytes() const { return arrayLength * sizeof(FingerprintType); }
+
+  // the memory of the table (empty if the filter is mapped)
+  const allocation::Block &Memory() const { return memory; }
 };
 
 struct t2val {
@@ -124,19 +222,22 @@ int applyBlock2(uint64_t* tmp, int b, int len, t2val_t * t2vals, int* alone, int
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
-    const ItemType* keys, const size_t start, const size_t end) {
+    const ItemType* keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch) {
 
     int m = arrayLength;
-    uint64_t* reverseOrder = new uint64_t[size];
-    uint8_t* reverseH = new uint8_t[size];
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, size);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, size);
     size_t reverseOrderPos;
     int hashIndex = 0;
-    t2val_t * t2vals = new t2val_t[m];
+    t2val_t * t2vals = scratch.get<t2val_t>(xorscratch::T2Vals, m);
+    int blocks = 1 + ((3 * blockLength) >> blockShift);
+    uint64_t* tmp = scratch.get<uint64_t>(xorscratch::Tmp, blocks << blockShift);
+    int* tmpc = scratch.get<int>(xorscratch::TmpCount, blocks);
+    int* alone = scratch.get<int>(xorscratch::Alone, arrayLength);
     while (true) {
         memset(t2vals, 0, sizeof(t2val_t[m]));
-        int blocks = 1 + ((3 * blockLength) >> blockShift);
-        uint64_t* tmp = new uint64_t[blocks << blockShift];
-        int* tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         for(size_t i = start; i < end; i++) {
             uint64_t k = keys[i];
             uint64_t hash = (*hasher)(k);
@@ -157,19 +258,15 @@ Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
         for (int b = 0; b < blocks; b++) {
             applyBlock(tmp, b, tmpc[b], t2vals);
         }
-        delete[] tmp;
-        delete[] tmpc;
         reverseOrderPos = 0;
 
-        int* alone = new int[arrayLength];
         int alonePos = 0;
         for (size_t i = 0; i < arrayLength; i++) {
             if (t2vals[i].t2count == 1) {
                 alone[alonePos++] = i;
             }
         }
-        tmp = new uint64_t[blocks << blockShift];
-        tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         reverseOrderPos = 0;
         int bestBlock = -1;
         while (reverseOrderPos < size) {
@@ -242,9 +339,6 @@ Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
             reverseH[reverseOrderPos] = found;
             reverseOrderPos++;
         }
-        delete[] tmp;
-        delete[] tmpc;
-        delete[] alone;
 
         if (reverseOrderPos == size) {
             break;
@@ -261,7 +355,7 @@ Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
@@ -286,6 +380,62 @@ Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
         }
         fingerprints[change] = xor2;
     }
+
+    return Ok;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+Status XorFilter<ItemType, FingerprintType, HashFamily>::AddAll(
+    const ItemType* keys, const size_t start, const size_t end,
+    const size_t threads) {
+    if (threads <= 1) {
+        return AddAll(keys, start, end);
+    }
+    uint64_t* reverseOrder = new uint64_t[size];
+    uint8_t* reverseH = new uint8_t[size];
+    t2val_t * t2vals = new t2val_t[arrayLength];
+    std::vector<size_t> roundEnds;
+    auto getHash = [this](uint64_t hash, int index) {
+        return getHashFromHash(hash, index, blockLength);
+    };
+    int hashIndex = 0;
+    while (true) {
+        xorparallel::countKeys(keys, start, end, *hasher, t2vals, arrayLength,
+            threads, getHash);
+        size_t reverseOrderPos = xorparallel::peel(t2vals, arrayLength,
+            reverseOrder, reverseH, roundEnds, threads, getHash);
+        if (reverseOrderPos == size) {
+            break;
+        }
+
+        std::cout << "WARNING: hashIndex " << hashIndex << "\n";
+        std::cout << (end - start) << " keys; arrayLength " << arrayLength
+            << " blockLength " << blockLength
+            << " reverseOrderPos " << reverseOrderPos << "\n";
+
+        hashIndex++;
+
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+
+    xorparallel::assignByRound(reverseOrder, reverseH, roundEnds, threads,
+        [this](uint64_t hash, int found) {
+        // keys peeled in the same round never use each other's entry
+        size_t change = 0;
+        FingerprintType xor2 = fingerprint(hash);
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, blockLength);
+            if (found == hi) {
+                change = h;
+            } else {
+                xor2 ^= fingerprints[h];
+            }
+        }
+        fingerprints[change] = xor2;
+    });
     delete [] t2vals;
     delete [] reverseOrder;
     delete [] reverseH;
@@ -309,6 +459,123 @@ Status XorFilter<ItemType, FingerprintType, HashFamily>::Contain(
     return f == 0 ? Ok : NotFound;
 }
 
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+void XorFilter<ItemType, FingerprintType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                __builtin_prefetch(fingerprints + getHashFromHash(hash, hi, blockLength));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = fingerprint(hash);
+            for (int hi = 0; hi < 3; hi++) {
+                f ^= fingerprints[getHashFromHash(hash, hi, blockLength)];
+            }
+            out[start + i] = f == 0;
+        }
+    }
+}
+
+template <typename Filter, typename ItemType, typename HashFamily,
+          typename FingerprintType>
+uint8_t contain8(const Filter &filter, const ItemType* keys,
+                 const HashFamily* hasher, const FingerprintType* fingerprints,
+                 uint32_t blockLength) {
+    uint8_t result = 0;
+    for (int i = 0; i < 8; i++) {
+        result |= (filter.Contain(keys[i]) == Ok) << i;
+    }
+    return result;
+}
+
+template <typename Filter>
+uint8_t contain8(const Filter &filter, const uint64_t* keys,
+                 const SimpleMixSplit* hasher, const uint8_t* fingerprints,
+                 uint32_t blockLength) {
+    return xor_contain8(keys, hasher->seed, blockLength, fingerprints,
+                        sizeof(uint8_t));
+}
+
+template <typename Filter>
+uint8_t contain8(const Filter &filter, const uint64_t* keys,
+                 const SimpleMixSplit* hasher, const uint16_t* fingerprints,
+                 uint32_t blockLength) {
+    return xor_contain8(keys, hasher->seed, blockLength, fingerprints,
+                        sizeof(uint16_t));
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+uint8_t XorFilter<ItemType, FingerprintType, HashFamily>::Contain8(
+    const ItemType* keys) const {
+    return contain8(*this, keys, hasher, fingerprints, blockLength);
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+Status XorFilter<ItemType, FingerprintType, HashFamily>::Save(
+    const char* path) const {
+    static_assert(std::is_trivially_copyable<HashFamily>::value &&
+                  sizeof(HashFamily) <= XOR_FILE_HASHER_SIZE,
+                  "the hash function state must fit in the file header");
+    xor_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.kind = XOR_FILE_KIND_XOR;
+    header.fingerprintBits = 8 * sizeof(FingerprintType);
+    header.hasherBytes = sizeof(HashFamily);
+    header.size = size;
+    header.arrayLength = arrayLength;
+    header.blockLength = blockLength;
+    memcpy(header.hasher, hasher, sizeof(HashFamily));
+    size_t dataBytes = (arrayLength + XOR_SIMD_PADDING) * sizeof(FingerprintType);
+    return xor_file_write(path, &header, fingerprints, dataBytes) ? Ok : IOError;
+}
+
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+XorFilter<ItemType, FingerprintType, HashFamily>::XorFilter(
+    const char* path, bool verify) {
+    static_assert(sizeof(xor_file_header_t) == XOR_FILE_HEADER_SIZE,
+                  "unexpected file header size");
+    static_assert(std::is_trivially_copyable<HashFamily>::value &&
+                  sizeof(HashFamily) <= XOR_FILE_HASHER_SIZE,
+                  "the hash function state must fit in the file header");
+    // the table is not allocated, but stays in the mapping
+    memory.data = nullptr;
+    memory.bytes = 0;
+    memory.policy = allocation::Heap;
+    mapping = xor_file_map(path, &mappingBytes);
+    if (mapping == nullptr) {
+        throw ::std::runtime_error("XorFilter: cannot map file");
+    }
+    const xor_file_header_t* header = (const xor_file_header_t*) mapping;
+    if (!xor_file_check(mapping, mappingBytes, XOR_FILE_KIND_XOR,
+                        8 * sizeof(FingerprintType), verify) ||
+        header->hasherBytes != sizeof(HashFamily) ||
+        header->blockLength != header->arrayLength / 3 ||
+        header->dataBytes !=
+            (header->arrayLength + XOR_SIMD_PADDING) * sizeof(FingerprintType)) {
+        xor_file_unmap(mapping, mappingBytes);
+        throw ::std::runtime_error("XorFilter: invalid file");
+    }
+    size = header->size;
+    arrayLength = header->arrayLength;
+    blockLength = header->blockLength;
+    // the seed is not stored, only the state of the hash function
+    seed = 0;
+    hasher = new HashFamily(seed);
+    memcpy(hasher, header->hasher, sizeof(HashFamily));
+    fingerprints = (FingerprintType*) ((const char*) mapping + XOR_FILE_HEADER_SIZE);
+}
+
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 std::string XorFilter<ItemType, FingerprintType, HashFamily>::Info() const {
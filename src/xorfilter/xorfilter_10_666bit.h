@@ -27,24 +27,29 @@ class XorFilter10_666 {
   size_t arrayLength;
   size_t blockLength;
   uint32_t *fingerprints;
+  allocation::Block memory;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline uint32_t fingerprint(const uint64_t hash) const {
     return (uint32_t) reduce(hash ^ (hash >> 32), fingerMul);
   }
 
  public:
-  explicit XorFilter10_666(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter10_666(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
-    fingerprints = new uint32_t[blockLength]();
+    memory = allocation::allocate(blockLength * sizeof(uint32_t));
+    fingerprints = (uint32_t *) memory.data;
   }
 
   ~XorFilter10_666() {
-    delete[] fingerprints;
+    allocation::deallocate(memory);
     delete hasher;
   }
 
@@ -53,6 +58,10 @@ class XorFilter10_666 {
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
   // number of current inserted items;
   size_t Size() const { return size; }
 
@@ -252,7 +261,7 @@ Status XorFilter10_666<ItemType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
@@ -307,5 +316,30 @@ Status XorFilter10_666<ItemType, HashFamily>::Contain(
     // return (((__uint128_t) f * (invFingerMul + 1)) >> 64) == f * 2996886421821121001L ? Ok : NotFound;
 }
 
+template <typename ItemType, typename HashFamily>
+void XorFilter10_666<ItemType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                __builtin_prefetch(fingerprints + getHashFromHash10(hash, hi, blockLength));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            uint32_t f = fingerprint(hash);
+            f += fingerprints[getHashFromHash10(hash, 0, blockLength)];
+            f += (((__uint128_t) fingerprints[getHashFromHash10(hash, 1, blockLength)] * (invFingerMul + 1)) >> 64);
+            f += (((__uint128_t) fingerprints[getHashFromHash10(hash, 2, blockLength)] * (invFingerMul2 + 1)) >> 64);
+            f -= (((__uint128_t) f * (invFingerMul + 1)) >> 64) * fingerMul;
+            out[start + i] = f == 0;
+        }
+    }
+}
+
 }  // namespace xorfilter
 #endif  // XOR_FILTER10_666_XOR_FILTER_H_
@@ -23,24 +23,29 @@ class XorFilter10 {
   size_t arrayLength;
   size_t blockLength;
   uint32_t *fingerprints;
+  allocation::Block memory;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline uint32_t fingerprint(const uint64_t hash) const {
     return (uint32_t) (hash ^ (hash >> 32));
   }
 
  public:
-  explicit XorFilter10(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter10(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
-    fingerprints = new uint32_t[blockLength]();
+    memory = allocation::allocate(blockLength * sizeof(uint32_t));
+    fingerprints = (uint32_t *) memory.data;
   }
 
   ~XorFilter10() {
-    delete[] fingerprints;
+    allocation::deallocate(memory);
     delete hasher;
   }
 
@@ -231,7 +236,7 @@ Status XorFilter10<ItemType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
@@ -19,25 +19,30 @@ class XorFilter13 {
   size_t blockLength;
   size_t byteCount;
   uint8_t *fingerprints;
+  allocation::Block memory;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline uint32_t fingerprint(const uint64_t hash) const {
     return (uint32_t) (hash ^ (hash >> 32));
   }
 
  public:
-  explicit XorFilter13(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter13(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
     byteCount = blockLength * 5 + 4;
-    fingerprints = new uint8_t[byteCount]();
+    memory = allocation::allocate(byteCount);
+    fingerprints = (uint8_t *) memory.data;
   }
 
   ~XorFilter13() {
-    delete[] fingerprints;
+    allocation::deallocate(memory);
     delete hasher;
   }
 
@@ -231,7 +236,7 @@ Status XorFilter13<ItemType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
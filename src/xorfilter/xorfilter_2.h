@@ -6,6 +6,7 @@
 
 #include "hashutil.h"
 #include "nbit_array.h"
+#include "xor_scratch.h"
 
 using namespace std;
 using namespace hashing;
@@ -49,14 +50,17 @@ class XorFilter2 {
   uint64_t fingerprintMask;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline FingerprintType fingerprint(const uint64_t hash) const {
     return (FingerprintType) hash ^ (hash >> 32);
   }
 
  public:
-  explicit XorFilter2(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter2(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
@@ -68,11 +72,23 @@ class XorFilter2 {
     delete hasher;
   }
 
-  Status AddAll(const vector<ItemType> data, const size_t start, const size_t end);
+  Status AddAll(const vector<ItemType> data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAll(data, start, end, scratch);
+  }
+
+  // Same as AddAll, but the temporary buffers are taken from (and kept in)
+  // the given scratch memory, so that they can be reused by the next build.
+  Status AddAll(const vector<ItemType> &data, const size_t start, const size_t end,
+                xorscratch::Scratch &scratch);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
@@ -122,18 +138,21 @@ int applyBlock2(uint64_t* tmp, int b, int len, t2val_t * t2vals, int* alone, int
 template <typename ItemType, typename FingerprintType,
           typename FingerprintStorageType, typename HashFamily>
 Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>::AddAll(
-    const vector<ItemType> keys, const size_t start, const size_t end) {
+    const vector<ItemType> &keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch) {
     int m = arrayLength;
-    uint64_t* reverseOrder = new uint64_t[size];
-    uint8_t* reverseH = new uint8_t[size];
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, size);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, size);
     size_t reverseOrderPos;
     int hashIndex = 0;
-    t2val_t * t2vals = new t2val_t[m];
+    t2val_t * t2vals = scratch.get<t2val_t>(xorscratch::T2Vals, m);
+    int blocks = 1 + ((3 * blockLength) >> blockShift);
+    uint64_t* tmp = scratch.get<uint64_t>(xorscratch::Tmp, blocks << blockShift);
+    int* tmpc = scratch.get<int>(xorscratch::TmpCount, blocks);
+    int* alone = scratch.get<int>(xorscratch::Alone, arrayLength);
     while (true) {
         memset(t2vals, 0, sizeof(t2val_t[m]));
-        int blocks = 1 + ((3 * blockLength) >> blockShift);
-        uint64_t* tmp = new uint64_t[blocks << blockShift];
-        int* tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         for(size_t i = start; i < end; i++) {
             uint64_t k = keys[i];
             uint64_t hash = (*hasher)(k);
@@ -154,19 +173,15 @@ Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>
         for (int b = 0; b < blocks; b++) {
             applyBlock(tmp, b, tmpc[b], t2vals);
         }
-        delete[] tmp;
-        delete[] tmpc;
         reverseOrderPos = 0;
 
-        int* alone = new int[arrayLength];
         int alonePos = 0;
         for (size_t i = 0; i < arrayLength; i++) {
             if (t2vals[i].t2count == 1) {
                 alone[alonePos++] = i;
             }
         }
-        tmp = new uint64_t[blocks << blockShift];
-        tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         reverseOrderPos = 0;
         int bestBlock = -1;
         while (reverseOrderPos < size) {
@@ -239,9 +254,6 @@ Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>
             reverseH[reverseOrderPos] = found;
             reverseOrderPos++;
         }
-        delete[] tmp;
-        delete[] tmpc;
-        delete[] alone;
 
         if (reverseOrderPos == size) {
             break;
@@ -258,11 +270,12 @@ Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
-    uint16_t* fp = new uint16_t[arrayLength]();
+    FingerprintType* fp = scratch.get<FingerprintType>(xorscratch::Fingerprints, arrayLength);
+    memset(fp, 0, sizeof(FingerprintType) * arrayLength);
     for (int i = reverseOrderPos - 1; i >= 0; i--) {
         // the hash of the key we insert next
         uint64_t hash = reverseOrder[i];
@@ -286,11 +299,6 @@ Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>
     }
     fingerprints->bulkSet(fp, arrayLength);
 
-    delete [] fp;
-    delete [] t2vals;
-    delete [] reverseOrder;
-    delete [] reverseH;
-
     return Ok;
 }
 
@@ -310,6 +318,31 @@ Status XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>
     return fingerprints->mask(f) == 0 ? Ok : NotFound;
 }
 
+template <typename ItemType, typename FingerprintType,
+          typename FingerprintStorageType, typename HashFamily>
+void XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                fingerprints->prefetch(getHashFromHash(hash, hi, blockLength));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = fingerprint(hash);
+            for (int hi = 0; hi < 3; hi++) {
+                f ^= fingerprints->get(getHashFromHash(hash, hi, blockLength));
+            }
+            out[start + i] = fingerprints->mask(f) == 0;
+        }
+    }
+}
+
 template <typename ItemType, typename FingerprintType,
           typename FingerprintStorageType, typename HashFamily>
 std::string XorFilter2<ItemType, FingerprintType, FingerprintStorageType, HashFamily>::Info() const {
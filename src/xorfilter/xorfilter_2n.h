@@ -57,14 +57,17 @@ class XorFilter2n {
   uint64_t fingerprintMask;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline FingerprintType fingerprint(const uint64_t hash) const {
     return (FingerprintType) fingerprints->mask(hash);
   }
 
  public:
-  explicit XorFilter2n(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilter2n(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = 1;
@@ -86,6 +89,10 @@ class XorFilter2n {
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
@@ -201,7 +208,7 @@ Status XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
@@ -251,6 +258,31 @@ Status XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily
     return fingerprint(f) == 0 ? Ok : NotFound;
 }
 
+template <typename ItemType, typename FingerprintType,
+          typename FingerprintStorageType, typename HashFamily>
+void XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                fingerprints->prefetch(getHashFromHash(hash, hi, blockLength));
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                f ^= fingerprints->get(getHashFromHash(hash, hi, blockLength));
+            }
+            out[start + i] = fingerprint(f) == 0;
+        }
+    }
+}
+
 template <typename ItemType, typename FingerprintType,
           typename FingerprintStorageType, typename HashFamily>
 std::string XorFilter2n<ItemType, FingerprintType, FingerprintStorageType, HashFamily>::Info() const {
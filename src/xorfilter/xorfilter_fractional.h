@@ -0,0 +1,372 @@
+#ifndef XOR_FILTER_FRACTIONAL_XOR_FILTER_H_
+#define XOR_FILTER_FRACTIONAL_XOR_FILTER_H_
+
+#include <assert.h>
+#include <algorithm>
+#include <sstream>
+#include <type_traits>
+#include "allocation.h"
+#include "hashutil.h"
+#include "xor_parallel.h"
+#include "xorfilter.h"
+
+using namespace std;
+using namespace hashing;
+
+namespace xorfilter {
+
+// The largest radix such that radix^digits - 1 is at most maxWord; that
+// is, such that a word holds digits numbers in [0, radix).
+constexpr bool radixFits(uint64_t radix, int digits, uint64_t maxWord) {
+  return digits == 0 || (radix - 1 <= maxWord &&
+                         radixFits(radix, digits - 1, (maxWord - (radix - 1)) / radix));
+}
+
+constexpr uint64_t largestRadix(int digits, uint64_t maxWord, uint64_t lo = 2,
+                                uint64_t hi = UINT64_C(1) << 32) {
+  return lo == hi ? lo
+         : radixFits(lo + (hi - lo + 1) / 2, digits, maxWord)
+             ? largestRadix(digits, maxWord, lo + (hi - lo + 1) / 2, hi)
+             : largestRadix(digits, maxWord, lo, lo + (hi - lo + 1) / 2 - 1);
+}
+
+// floor(x / d) for all words x, as a multiplication by a precomputed
+// reciprocal (see Lemire et al., "Faster Remainder by Direct Computation").
+// d must be at most half the largest word.
+template <typename WordType>
+struct Divider;
+
+template <>
+struct Divider<uint32_t> {
+  // ceil(2^63 / d)
+  uint64_t c;
+  void set(uint64_t d) { c = (UINT64_C(0x7FFFFFFFFFFFFFFF)) / d + 1; }
+  inline uint64_t divide(uint32_t x) const {
+    return (uint64_t) (((__uint128_t) x * c) >> 63);
+  }
+};
+
+template <>
+struct Divider<uint64_t> {
+  // ceil(2^127 / d)
+  __uint128_t c;
+  void set(uint64_t d) { c = (((__uint128_t) 1 << 127) - 1) / d + 1; }
+  inline uint64_t divide(uint64_t x) const {
+    // the 192-bit product x * c, shifted right by 127
+    __uint128_t low = ((__uint128_t) x * (uint64_t) c) >> 64;
+    __uint128_t high = (__uint128_t) x * (uint64_t) (c >> 64);
+    return (uint64_t) ((high + low) >> 63);
+  }
+};
+
+// Xor filter with fractional fingerprint sizes, generalizing
+// XorFilter10_666: each word holds fingerprintsPerWord fingerprints, as the
+// digits of the word in base radix, the largest base for which they fit.
+// For example, 5 digits per uint32_t give 6.39 bits per fingerprint, 7 per
+// uint64_t give 9.14 bits, 5 per uint64_t give 12.8 bits. Instead of the
+// xor, a key matches if the sum of its fingerprint and of its three
+// entries is 0 modulo radix, so the false positive rate is 1 / radix. Each
+// entry is read with one load.
+template <typename ItemType, int fingerprintsPerWord,
+          typename WordType = uint32_t,
+          typename HashFamily = TwoIndependentMultiplyShift>
+class XorFilterFractional {
+  static_assert(sizeof(WordType) == 4 || sizeof(WordType) == 8,
+                "the words must be uint32_t or uint64_t");
+  static_assert(fingerprintsPerWord >= 2 &&
+                fingerprintsPerWord <= 8 * (int) sizeof(WordType),
+                "fingerprintsPerWord must be between 2 and the word size");
+
+ public:
+  // the base of the digits
+  static const uint64_t radix = largestRadix(fingerprintsPerWord, (WordType) -1);
+
+  size_t size;
+  // number of entries (digits)
+  size_t arrayLength;
+  size_t blockLength;
+  size_t wordCount;
+  WordType *fingerprints;
+  allocation::Block memory;
+
+  // divides a word by radix^d, for digit d
+  Divider<WordType> dividers[fingerprintsPerWord];
+  // radix^d
+  WordType powers[fingerprintsPerWord];
+
+  HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
+
+  // large enough for the sum of a fingerprint and three words
+  typedef typename std::conditional<sizeof(WordType) == 4, uint64_t,
+                                    __uint128_t>::type SumType;
+
+  static inline uint64_t reduceSum(uint64_t sum) { return sum % radix; }
+
+  static inline uint64_t reduceSum(__uint128_t sum) {
+    // sum >> 64 is at most 3
+    return ((uint64_t) sum % radix +
+            (uint64_t) (sum >> 64) * (UINT64_C(0xFFFFFFFFFFFFFFFF) % radix + 1)) % radix;
+  }
+
+  inline uint64_t fingerprint(const uint64_t hash) const {
+    return (uint64_t) (uint32_t) (hash ^ (hash >> 32)) * radix >> 32;
+  }
+
+  // digit d of the word x, that is, entry d of the word
+  inline uint64_t digit(WordType x, int d) const {
+    return dividers[d].divide(x) % radix;
+  }
+
+  // The sum of the fingerprint and of the three entries of a key, modulo
+  // radix. Each entry is the word divided by radix^d: the higher digits
+  // only add multiples of radix.
+  inline uint64_t sum(uint64_t hash) const {
+    SumType sum = fingerprint(hash);
+    for (int hi = 0; hi < 3; hi++) {
+      size_t h = getHashFromHash(hash, hi, blockLength);
+      sum += dividers[h % fingerprintsPerWord].divide(fingerprints[h / fingerprintsPerWord]);
+    }
+    return reduceSum(sum);
+  }
+
+  explicit XorFilterFractional(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
+    this->size = size;
+    this->arrayLength = 32 + 1.23 * size;
+    this->blockLength = arrayLength / 3;
+    this->wordCount = (3 * blockLength + fingerprintsPerWord - 1) / fingerprintsPerWord;
+    memory = allocation::allocate(wordCount * sizeof(WordType));
+    fingerprints = (WordType*) memory.data;
+    WordType p = 1;
+    for (int d = 0; d < fingerprintsPerWord; d++) {
+      powers[d] = p;
+      dividers[d].set(p);
+      p *= radix;
+    }
+  }
+
+  // Copy the filter, including its table.
+  XorFilterFractional(const XorFilterFractional &o) {
+    seed = o.seed;
+    hasher = new HashFamily(*o.hasher);
+    size = o.size;
+    arrayLength = o.arrayLength;
+    blockLength = o.blockLength;
+    wordCount = o.wordCount;
+    memory = allocation::allocate(wordCount * sizeof(WordType));
+    fingerprints = (WordType*) memory.data;
+    memcpy(fingerprints, o.fingerprints, wordCount * sizeof(WordType));
+    for (int d = 0; d < fingerprintsPerWord; d++) {
+      powers[d] = o.powers[d];
+      dividers[d] = o.dividers[d];
+    }
+  }
+
+  ~XorFilterFractional() {
+    allocation::deallocate(memory);
+    delete hasher;
+  }
+
+  Status AddAll(const vector<ItemType> &data, const size_t start, const size_t end) {
+      return AddAll(data.data(), start, end, 1);
+  }
+
+  // Hashing, peeling and assignment use up to the given number of threads.
+  Status AddAll(const ItemType* data, const size_t start, const size_t end,
+                const size_t threads);
+
+  // Report if the item is inserted, with false positive rate.
+  Status Contain(const ItemType &item) const;
+
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
+  /* methods for providing stats  */
+  // summary infomation
+  std::string Info() const;
+
+  // number of current inserted items;
+  size_t Size() const { return size; }
+
+  // size of the filter in bytes.
+  size_t SizeInBytes() const { return wordCount * sizeof(WordType); }
+
+  // the memory of the table
+  const allocation::Block &Memory() const { return memory; }
+
+ private:
+  XorFilterFractional& operator=(const XorFilterFractional&) = delete;
+
+  // count and peel the keys with the calling thread; returns the number of
+  // keys peeled
+  size_t Peel(const ItemType* keys, const size_t start, const size_t end,
+              t2val_t* t2vals, uint64_t* reverseOrder, uint8_t* reverseH);
+};
+
+template <typename ItemType, int fingerprintsPerWord, typename WordType,
+          typename HashFamily>
+size_t XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>::Peel(
+    const ItemType* keys, const size_t start, const size_t end,
+    t2val_t* t2vals, uint64_t* reverseOrder, uint8_t* reverseH) {
+    memset(t2vals, 0, sizeof(t2val_t) * arrayLength);
+    for (size_t i = start; i < end; i++) {
+        uint64_t hash = (*hasher)(keys[i]);
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, blockLength);
+            t2vals[h].t2count++;
+            t2vals[h].t2 ^= hash;
+        }
+    }
+    std::vector<uint32_t> alone;
+    for (size_t i = 0; i < arrayLength; i++) {
+        if (t2vals[i].t2count == 1) {
+            alone.push_back(i);
+        }
+    }
+    size_t reverseOrderPos = 0;
+    while (!alone.empty()) {
+        size_t i = alone.back();
+        alone.pop_back();
+        if (t2vals[i].t2count == 0) {
+            continue;
+        }
+        uint64_t hash = t2vals[i].t2;
+        uint8_t found = -1;
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, blockLength);
+            if (h == i) {
+                found = (uint8_t) hi;
+                t2vals[i].t2count = 0;
+            } else {
+                if (--t2vals[h].t2count == 1) {
+                    alone.push_back(h);
+                }
+                t2vals[h].t2 ^= hash;
+            }
+        }
+        reverseOrder[reverseOrderPos] = hash;
+        reverseH[reverseOrderPos] = found;
+        reverseOrderPos++;
+    }
+    return reverseOrderPos;
+}
+
+template <typename ItemType, int fingerprintsPerWord, typename WordType,
+          typename HashFamily>
+Status XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>::AddAll(
+    const ItemType* keys, const size_t start, const size_t end,
+    const size_t threads) {
+    uint64_t* reverseOrder = new uint64_t[size];
+    uint8_t* reverseH = new uint8_t[size];
+    t2val_t * t2vals = new t2val_t[arrayLength];
+    std::vector<size_t> roundEnds;
+    auto getHash = [this](uint64_t hash, int index) {
+        return getHashFromHash(hash, index, blockLength);
+    };
+    int hashIndex = 0;
+    while (true) {
+        size_t reverseOrderPos;
+        if (threads <= 1) {
+            reverseOrderPos = Peel(keys, start, end, t2vals, reverseOrder, reverseH);
+            // one key per round, in the order they were peeled
+            roundEnds.resize(reverseOrderPos);
+            for (size_t i = 0; i < reverseOrderPos; i++) {
+                roundEnds[i] = i + 1;
+            }
+        } else {
+            xorparallel::countKeys(keys, start, end, *hasher, t2vals, arrayLength,
+                threads, getHash);
+            reverseOrderPos = xorparallel::peel(t2vals, arrayLength,
+                reverseOrder, reverseH, roundEnds, threads, getHash);
+        }
+        if (reverseOrderPos == size) {
+            break;
+        }
+
+        std::cout << "WARNING: hashIndex " << hashIndex << "\n";
+        std::cout << (end - start) << " keys; arrayLength " << arrayLength
+            << " blockLength " << blockLength
+            << " reverseOrderPos " << reverseOrderPos << "\n";
+
+        hashIndex++;
+
+        // use a new random numbers
+        delete hasher;
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
+    }
+
+    memset(fingerprints, 0, wordCount * sizeof(WordType));
+    xorparallel::assignByRound(reverseOrder, reverseH, roundEnds, threads,
+        [this](uint64_t hash, int found) {
+        // keys peeled in the same round never use each other's entry, but
+        // may use other entries of the same word: the words are updated
+        // atomically, and setting a digit never changes the others
+        size_t change = 0;
+        uint64_t sum = fingerprint(hash);
+        for (int hi = 0; hi < 3; hi++) {
+            size_t h = getHashFromHash(hash, hi, blockLength);
+            if (found == hi) {
+                change = h;
+            } else {
+                WordType x = __atomic_load_n(&fingerprints[h / fingerprintsPerWord],
+                                             __ATOMIC_RELAXED);
+                sum += digit(x, h % fingerprintsPerWord);
+            }
+        }
+        // the entry was 0: set it such that the sum is 0 modulo radix
+        WordType set = (radix - sum % radix) % radix;
+        __atomic_fetch_add(&fingerprints[change / fingerprintsPerWord],
+                           (WordType) (set * powers[change % fingerprintsPerWord]),
+                           __ATOMIC_RELAXED);
+    });
+    delete [] t2vals;
+    delete [] reverseOrder;
+    delete [] reverseH;
+
+    return Ok;
+}
+
+template <typename ItemType, int fingerprintsPerWord, typename WordType,
+          typename HashFamily>
+Status XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>::Contain(
+    const ItemType &key) const {
+    uint64_t hash = (*hasher)(key);
+    return sum(hash) == 0 ? Ok : NotFound;
+}
+
+template <typename ItemType, int fingerprintsPerWord, typename WordType,
+          typename HashFamily>
+void XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            for (int hi = 0; hi < 3; hi++) {
+                __builtin_prefetch(fingerprints +
+                    getHashFromHash(hash, hi, blockLength) / fingerprintsPerWord);
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            out[start + i] = sum(hashes[i]) == 0;
+        }
+    }
+}
+
+template <typename ItemType, int fingerprintsPerWord, typename WordType,
+          typename HashFamily>
+std::string XorFilterFractional<ItemType, fingerprintsPerWord, WordType, HashFamily>::Info() const {
+  std::stringstream ss;
+  ss << "XorFilterFractional Status:\n"
+     << "\t\tKeys stored: " << Size() << "\n"
+     << "\t\tRadix: " << radix << "\n";
+  return ss.str();
+}
+}  // namespace xorfilter
+#endif  // XOR_FILTER_FRACTIONAL_XOR_FILTER_H_
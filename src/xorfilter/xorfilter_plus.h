@@ -4,7 +4,9 @@
 #include <assert.h>
 #include <algorithm>
 
+#include "allocation.h"
 #include "hashutil.h"
+#include "xor_scratch.h"
 
 using namespace std;
 using namespace hashing;
@@ -37,22 +39,23 @@ class Rank9 {
     uint64_t bitsArraySize;
     uint64_t* counts;
     uint64_t countsArraySize;
+    allocation::Block bitsMemory;
+    allocation::Block countsMemory;
 
 public:
 
     Rank9(uint64_t* sourceBits, size_t bitCount) {
         // One zero entry is needed at the end
         bitsArraySize = 1 + (size_t) ((bitCount + 63) / 64);
-        bits = new uint64_t[bitsArraySize];
+        bitsMemory = allocation::allocate(bitsArraySize * sizeof(uint64_t));
+        bits = (uint64_t*) bitsMemory.data;
         memcpy(bits, sourceBits, (bitsArraySize - 1) * sizeof(uint64_t));
-        bits[bitsArraySize - 1] = 0;
         uint64_t length = bitsArraySize * 64;
         size_t numWords = (size_t) ((length + 63) / 64);
         size_t numCounts = (size_t) ((length + 8 * 64 - 1) / (8 * 64)) * 2;
         countsArraySize = numCounts + 1;
-        counts = new uint64_t[countsArraySize];
-        // just to be sure
-        memset(counts, 0, sizeof(uint64_t[countsArraySize]));
+        countsMemory = allocation::allocate(countsArraySize * sizeof(uint64_t));
+        counts = (uint64_t*) countsMemory.data;
         uint64_t c = 0;
         uint64_t pos = 0;
         for (uint64_t i = 0; i < numWords; i += 8, pos += 2) {
@@ -70,8 +73,8 @@ public:
     }
 
     ~Rank9() {
-        delete[] bits;
-        delete[] counts;
+        allocation::deallocate(bitsMemory);
+        allocation::deallocate(countsMemory);
     }
 
     uint64_t rank(uint64_t pos) {
@@ -102,6 +105,12 @@ public:
                 ((counts[block + 1] >> (offset + ((offset >> 28) & 8)) * 9) & 0x1ff);
     }
 
+    void prefetch(uint64_t pos) {
+        uint64_t word = pos >> 6;
+        __builtin_prefetch(bits + word);
+        __builtin_prefetch(counts + ((word >> 2) & ~1));
+    }
+
     uint64_t getBitCount() {
         return bitsArraySize * 64 + countsArraySize * 64;
     }
@@ -166,18 +175,22 @@ class XorFilterPlus {
   size_t arrayLength;
   size_t blockLength;
   FingerprintType *fingerprints = NULL;
+  allocation::Block memory = {NULL, 0, allocation::Heap};
   Rank9 *rank = NULL;
   size_t totalSizeInBytes;
 
   HashFamily* hasher;
+  // the hash functions are derived from this seed
+  uint64_t seed;
 
   inline FingerprintType fingerprint(const uint64_t hash) const {
     return (FingerprintType) (hash ^ (hash >> 32));
   }
 
  public:
-  explicit XorFilterPlus(const size_t size) {
-    hasher = new HashFamily();
+  explicit XorFilterPlus(const size_t size, uint64_t seed = randomSeed()) {
+    this->seed = seed;
+    hasher = new HashFamily(deriveSeed(seed, 0));
     this->size = size;
     this->arrayLength = 32 + 1.23 * size;
     this->blockLength = arrayLength / 3;
@@ -185,9 +198,7 @@ class XorFilterPlus {
 
   ~XorFilterPlus() {
     delete hasher;
-    if (fingerprints != NULL) {
-        delete[] fingerprints;
-    }
+    allocation::deallocate(memory);
     if (rank != 0) {
         delete rank;
     }
@@ -196,11 +207,23 @@ class XorFilterPlus {
   Status AddAll(const vector<ItemType>& data, const size_t start, const size_t end) {
       return AddAll(data.data(), start, end);
   }
-  Status AddAll(const ItemType * data, const size_t start, const size_t end);
+  Status AddAll(const ItemType * data, const size_t start, const size_t end) {
+      xorscratch::Scratch scratch;
+      return AddAll(data, start, end, scratch);
+  }
+
+  // Same as AddAll, but the temporary buffers are taken from (and kept in)
+  // the given scratch memory, so that they can be reused by the next build.
+  Status AddAll(const ItemType * data, const size_t start, const size_t end,
+                xorscratch::Scratch &scratch);
 
   // Report if the item is inserted, with false positive rate.
   Status Contain(const ItemType &item) const;
 
+  // Contain for n keys at once: out[i] = 1 if keys[i] may be in the set,
+  // 0 otherwise (see containBatchSize).
+  void ContainBatch(const ItemType* keys, size_t n, uint8_t* out) const;
+
   /* methods for providing stats  */
   // summary infomation
   std::string Info() const;
@@ -215,18 +238,24 @@ class XorFilterPlus {
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
-    const ItemType* keys, const size_t start, const size_t end) {
+    const ItemType* keys, const size_t start, const size_t end,
+    xorscratch::Scratch &scratch) {
     int m = arrayLength;
-    uint64_t* reverseOrder = new uint64_t[size];
-    uint8_t* reverseH = new uint8_t[size];
+    uint64_t* reverseOrder = scratch.get<uint64_t>(xorscratch::ReverseOrder, size);
+    uint8_t* reverseH = scratch.get<uint8_t>(xorscratch::ReverseH, size);
     size_t reverseOrderPos;
     int hashIndex = 0;
-    t2val_t * t2vals = new t2val_t[m];
+    t2val_t * t2vals = scratch.get<t2val_t>(xorscratch::T2Vals, m);
+    int blocks = 1 + (3 * blockLength) / BLOCK_LEN;
+    uint64_t* tmp = scratch.get<uint64_t>(xorscratch::Tmp, blocks * BLOCK_LEN);
+    int* tmpc = scratch.get<int>(xorscratch::TmpCount, blocks);
+    int* alone[3];
+    alone[0] = scratch.get<int>(xorscratch::Alone, blockLength);
+    alone[1] = scratch.get<int>(xorscratch::Alone1, blockLength);
+    alone[2] = scratch.get<int>(xorscratch::Alone2, blockLength);
     while (true) {
         memset(t2vals, 0, sizeof(t2val_t[m]));
-        int blocks = 1 + (3 * blockLength) / BLOCK_LEN;
-        uint64_t* tmp = new uint64_t[blocks * BLOCK_LEN];
-        int* tmpc = new int[blocks]();
+        memset(tmpc, 0, sizeof(int[blocks]));
         for(size_t i = start; i < end; i++) {
             uint64_t k = keys[i];
             uint64_t hash = (*hasher)(k);
@@ -246,14 +275,8 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
         for (int b = 0; b < blocks; b++) {
             applyBlock(tmp, b, tmpc[b], t2vals);
         }
-        delete[] tmp;
-        delete[] tmpc;
 
         reverseOrderPos = 0;
-        int* alone[3];
-        alone[0] = new int[blockLength];
-        alone[1] = new int[blockLength];
-        alone[2] = new int[blockLength];
         int alonePos[] = {0, 0, 0};
         for(int nextAlone = 0; nextAlone < 3; nextAlone++) {
             for (size_t i = 0; i < blockLength; i++) {
@@ -298,9 +321,6 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
             reverseH[reverseOrderPos] = found;
             reverseOrderPos++;
         }
-        delete [] alone[0];
-        delete [] alone[1];
-        delete [] alone[2];
         if (reverseOrderPos == size) {
             break;
         }
@@ -316,11 +336,11 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
 
         // use a new random numbers
         delete hasher;
-        hasher = new HashFamily();
+        hasher = new HashFamily(deriveSeed(seed, hashIndex));
 
     }
 
-    FingerprintType *fp = new FingerprintType[3 * blockLength];
+    FingerprintType *fp = scratch.get<FingerprintType>(xorscratch::Fingerprints, 3 * blockLength);
     std::fill_n(fp, 3 * blockLength, 0);
     for (int i = reverseOrderPos - 1; i >= 0; i--) {
         // the hash of the key we insert next
@@ -344,10 +364,6 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
         fp[change] = xor2;
     }
 
-    delete [] t2vals;
-    delete [] reverseOrder;
-    delete [] reverseH;
-
     uint64_t bitCount = blockLength;
     uint64_t *bits = new uint64_t[(bitCount + 63) / 64]();
     int setBits = 0;
@@ -358,21 +374,19 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::AddAll(
             setBits++;
         }
     }
-    fingerprints = new FingerprintType[2 * blockLength + setBits];
+    allocation::deallocate(memory);
+    memory = allocation::allocate((2 * blockLength + setBits) * sizeof(FingerprintType));
+    fingerprints = (FingerprintType*) memory.data;
     for (size_t i = 0; i < 2 * blockLength; i++) {
         fingerprints[i] = fp[i];
     }
-    // there are setBits uninitialized values?
-    for (size_t i = 2 * blockLength; i < 2 * blockLength + setBits; i++) {
-        fingerprints[i] = 0; // to be verified?
-    }
     for (size_t i = 2 * blockLength, j = i; i < 3 * blockLength;) {
         FingerprintType f = fp[i++];
         if (f != 0) {
             fingerprints[j++] = f;
         }
     }
-    delete [] fp;
+    delete rank;
     rank = new Rank9(bits, bitCount);
     delete [] bits;
     totalSizeInBytes = (2 * blockLength + setBits) * sizeof(FingerprintType)
@@ -401,6 +415,47 @@ Status XorFilterPlus<ItemType, FingerprintType, HashFamily>::Contain(
     return f == 0 ? Ok : NotFound;
 }
 
+// the third entry depends on the rank, so this prefetches in two steps:
+// first the first two entries and the rank data, then the third entry
+template <typename ItemType, typename FingerprintType,
+          typename HashFamily>
+void XorFilterPlus<ItemType, FingerprintType, HashFamily>::ContainBatch(
+    const ItemType* keys, size_t n, uint8_t* out) const {
+    uint64_t hashes[containBatchSize];
+    // index of the third entry, or 0 if the key has none
+    size_t h2s[containBatchSize];
+    for (size_t start = 0; start < n; start += containBatchSize) {
+        size_t len = std::min(containBatchSize, n - start);
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = (*hasher)(keys[start + i]);
+            hashes[i] = hash;
+            __builtin_prefetch(fingerprints + getHashFromHash(hash, 0, blockLength));
+            __builtin_prefetch(fingerprints + getHashFromHash(hash, 1, blockLength));
+            rank->prefetch(reduce((uint32_t) rotl64(hash, 42), blockLength));
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint32_t h2a = reduce((uint32_t) rotl64(hashes[i], 42), blockLength);
+            uint64_t bitAndPartialRank = rank->getAndPartialRank(h2a);
+            h2s[i] = 0;
+            if ((bitAndPartialRank & 1) == 1) {
+                uint32_t h2x = (uint32_t) ((bitAndPartialRank >> 1) + rank->remainingRank(h2a));
+                h2s[i] = h2x + 2 * blockLength;
+                __builtin_prefetch(fingerprints + h2s[i]);
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            uint64_t hash = hashes[i];
+            FingerprintType f = (FingerprintType) fingerprint(hash);
+            f ^= fingerprints[getHashFromHash(hash, 0, blockLength)];
+            f ^= fingerprints[getHashFromHash(hash, 1, blockLength)];
+            if (h2s[i] != 0) {
+                f ^= fingerprints[h2s[i]];
+            }
+            out[start + i] = f == 0;
+        }
+    }
+}
+
 template <typename ItemType, typename FingerprintType,
           typename HashFamily>
 std::string XorFilterPlus<ItemType, FingerprintType, HashFamily>::Info() const {
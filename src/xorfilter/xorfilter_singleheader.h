@@ -7,6 +7,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "xor_file.h"
+#include "xor_simd.h"
+
 /**
  * We assume that you have a large set of 64-bit integers
  * and you want a data structure to do membership tests using
@@ -81,6 +84,19 @@ static inline bool xor8_contain(uint64_t key, const xor8_t *filter) {
        filter->fingerprints[h2]);
 }
 
+// Report which of the 8 keys are in the set (bit i for keys[i]), with false
+// positive rate. Uses AVX-512 or AVX2 if the processor supports it.
+static inline uint8_t xor8_contain8(const uint64_t *keys, const xor8_t *filter) {
+  return xor_contain8(keys, filter->seed, filter->blockLength,
+                      filter->fingerprints, sizeof(uint8_t));
+}
+
+// Same as xor8_contain8, for 16 keys.
+static inline uint16_t xor8_contain16(const uint64_t *keys, const xor8_t *filter) {
+  return xor8_contain8(keys, filter) |
+         ((uint16_t)xor8_contain8(keys + 8, filter) << 8);
+}
+
 typedef struct xor16_s {
   uint64_t seed;
   uint64_t blockLength;
@@ -102,12 +118,27 @@ static inline bool xor16_contain(uint64_t key, const xor16_t *filter) {
        filter->fingerprints[h2]);
 }
 
+// Report which of the 8 keys are in the set (bit i for keys[i]), with false
+// positive rate. Uses AVX-512 or AVX2 if the processor supports it.
+static inline uint8_t xor16_contain8(const uint64_t *keys, const xor16_t *filter) {
+  return xor_contain8(keys, filter->seed, filter->blockLength,
+                      filter->fingerprints, sizeof(uint16_t));
+}
+
+// Same as xor16_contain8, for 16 keys.
+static inline uint16_t xor16_contain16(const uint64_t *keys, const xor16_t *filter) {
+  return xor16_contain8(keys, filter) |
+         ((uint16_t)xor16_contain8(keys + 8, filter) << 8);
+}
+
 // allocate enough capacity for a set containing up to 'size' elements
 // caller is responsible to call xor8_free(filter)
 static inline bool xor8_allocate(uint32_t size, xor8_t *filter) {
   size_t capacity = 32 + 1.23 * size;
   capacity = capacity / 3 * 3;
-  filter->fingerprints = (uint8_t *)malloc(capacity * sizeof(uint8_t));
+  // padding for the gathers in xor8_contain8
+  filter->fingerprints =
+      (uint8_t *)calloc(capacity + XOR_SIMD_PADDING, sizeof(uint8_t));
   if (filter->fingerprints != NULL) {
     filter->blockLength = capacity / 3;
     return true;
@@ -122,7 +153,9 @@ static inline bool xor16_allocate(uint32_t size, xor16_t *filter) {
   size_t capacity = 32 + 1.23 * size;
   filter->blockLength = capacity / 3;
   capacity = capacity / 3 * 3;
-  filter->fingerprints = (uint16_t *)malloc(capacity * sizeof(uint16_t));
+  // padding for the gathers in xor16_contain8
+  filter->fingerprints =
+      (uint16_t *)calloc(capacity + XOR_SIMD_PADDING, sizeof(uint16_t));
   if (filter->fingerprints != NULL) {
     filter->blockLength = capacity / 3;
     return true;
@@ -155,6 +188,140 @@ static inline void xor16_free(xor16_t *filter) {
   filter->blockLength = 0;
 }
 
+// Write the filter to a file, in the format of xor_file.h. The file can
+// also be mapped by XorFilter<uint64_t, uint8_t, SimpleMixSplit>. size is
+// the number of keys the filter was populated with (the filter itself does
+// not keep it). Returns false on failure.
+static inline bool xor8_save(const xor8_t *filter, uint64_t size,
+                              const char *path) {
+  xor_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.kind = XOR_FILE_KIND_XOR;
+  header.fingerprintBits = 8 * sizeof(uint8_t);
+  header.hasherBytes = sizeof(filter->seed);
+  header.size = size;
+  header.arrayLength = 3 * filter->blockLength;
+  header.blockLength = filter->blockLength;
+  memcpy(header.hasher, &filter->seed, sizeof(filter->seed));
+  return xor_file_write(path, &header, filter->fingerprints,
+                        (header.arrayLength + XOR_SIMD_PADDING) * sizeof(uint8_t));
+}
+
+// Use a filter written by xor8_save, stored in the given buffer, without
+// copying the fingerprints. The buffer must stay valid while the filter is
+// used, and the filter must not be freed or populated. If verify is true,
+// the checksum is checked. Returns false if the buffer is not a valid filter.
+static inline bool xor8_view(const void *buffer, size_t len, xor8_t *filter,
+                             bool verify) {
+  if (!xor_file_check(buffer, len, XOR_FILE_KIND_XOR, 8 * sizeof(uint8_t),
+                      verify)) {
+    return false;
+  }
+  const xor_file_header_t *header = (const xor_file_header_t *)buffer;
+  if (header->hasherBytes != sizeof(filter->seed) ||
+      header->blockLength != header->arrayLength / 3 ||
+      header->dataBytes !=
+          (header->arrayLength + XOR_SIMD_PADDING) * sizeof(uint8_t)) {
+    return false;
+  }
+  memcpy(&filter->seed, header->hasher, sizeof(filter->seed));
+  filter->blockLength = header->blockLength;
+  filter->fingerprints = (uint8_t *)((const char *)buffer + XOR_FILE_HEADER_SIZE);
+  return true;
+}
+
+// Map a filter written by xor8_save. Returns false on failure; otherwise,
+// the caller is responsible for calling xor8_unmap(filter) (not xor8_free).
+static inline bool xor8_map(const char *path, xor8_t *filter, bool verify) {
+  size_t len;
+  const void *buffer = xor_file_map(path, &len);
+  if (buffer == NULL) {
+    return false;
+  }
+  if (!xor8_view(buffer, len, filter, verify)) {
+    xor_file_unmap(buffer, len);
+    return false;
+  }
+  return true;
+}
+
+// release a filter mapped by xor8_map
+static inline void xor8_unmap(xor8_t *filter) {
+  const xor_file_header_t *header =
+      (const xor_file_header_t *)((const char *)filter->fingerprints -
+                                  XOR_FILE_HEADER_SIZE);
+  xor_file_unmap(header, XOR_FILE_HEADER_SIZE + header->dataBytes);
+  filter->fingerprints = NULL;
+  filter->blockLength = 0;
+}
+
+// Write the filter to a file, in the format of xor_file.h. The file can
+// also be mapped by XorFilter<uint64_t, uint16_t, SimpleMixSplit>. size is
+// the number of keys the filter was populated with (the filter itself does
+// not keep it). Returns false on failure.
+static inline bool xor16_save(const xor16_t *filter, uint64_t size,
+                               const char *path) {
+  xor_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.kind = XOR_FILE_KIND_XOR;
+  header.fingerprintBits = 8 * sizeof(uint16_t);
+  header.hasherBytes = sizeof(filter->seed);
+  header.size = size;
+  header.arrayLength = 3 * filter->blockLength;
+  header.blockLength = filter->blockLength;
+  memcpy(header.hasher, &filter->seed, sizeof(filter->seed));
+  return xor_file_write(path, &header, filter->fingerprints,
+                        (header.arrayLength + XOR_SIMD_PADDING) * sizeof(uint16_t));
+}
+
+// Use a filter written by xor16_save, stored in the given buffer, without
+// copying the fingerprints. The buffer must stay valid while the filter is
+// used, and the filter must not be freed or populated. If verify is true,
+// the checksum is checked. Returns false if the buffer is not a valid filter.
+static inline bool xor16_view(const void *buffer, size_t len, xor16_t *filter,
+                             bool verify) {
+  if (!xor_file_check(buffer, len, XOR_FILE_KIND_XOR, 8 * sizeof(uint16_t),
+                      verify)) {
+    return false;
+  }
+  const xor_file_header_t *header = (const xor_file_header_t *)buffer;
+  if (header->hasherBytes != sizeof(filter->seed) ||
+      header->blockLength != header->arrayLength / 3 ||
+      header->dataBytes !=
+          (header->arrayLength + XOR_SIMD_PADDING) * sizeof(uint16_t)) {
+    return false;
+  }
+  memcpy(&filter->seed, header->hasher, sizeof(filter->seed));
+  filter->blockLength = header->blockLength;
+  filter->fingerprints = (uint16_t *)((const char *)buffer + XOR_FILE_HEADER_SIZE);
+  return true;
+}
+
+// Map a filter written by xor16_save. Returns false on failure; otherwise,
+// the caller is responsible for calling xor16_unmap(filter) (not xor16_free).
+static inline bool xor16_map(const char *path, xor16_t *filter, bool verify) {
+  size_t len;
+  const void *buffer = xor_file_map(path, &len);
+  if (buffer == NULL) {
+    return false;
+  }
+  if (!xor16_view(buffer, len, filter, verify)) {
+    xor_file_unmap(buffer, len);
+    return false;
+  }
+  return true;
+}
+
+// release a filter mapped by xor16_map
+static inline void xor16_unmap(xor16_t *filter) {
+  const xor_file_header_t *header =
+      (const xor_file_header_t *)((const char *)filter->fingerprints -
+                                  XOR_FILE_HEADER_SIZE);
+  xor_file_unmap(header, XOR_FILE_HEADER_SIZE + header->dataBytes);
+  filter->fingerprints = NULL;
+  filter->blockLength = 0;
+}
+
 struct xor_xorset_s {
   uint64_t xormask;
   uint32_t count;
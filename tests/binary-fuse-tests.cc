@@ -0,0 +1,64 @@
+// Tests of the binary fuse filter. Build and run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <iostream>
+#include <vector>
+
+#include "binaryfusefilter.h"
+#include "random.h"
+
+using namespace std;
+using namespace binaryfusefilter;
+
+// Every added key is found, for small and larger sets, with and without
+// sorting the hashes first.
+template <typename Filter>
+void testContain() {
+  for (size_t n : {0, 1, 10, 1000, 100000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n);
+    for (bool sorted : {false, true}) {
+      Filter filter(n);
+      Status s = sorted ? filter.AddAllSorted(keys.data(), 0, n)
+                        : filter.AddAll(keys, 0, n);
+      assert(s == Ok);
+      for (uint64_t k : keys) {
+        assert(filter.Contain(k) == Ok);
+      }
+    }
+  }
+}
+
+// Duplicate keys, a few or many copies of the same key, are allowed.
+template <typename Filter>
+void testDuplicates() {
+  for (size_t n : {10, 1000, 100000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n);
+    for (size_t i = 0; i < n / 10; i++) {
+      keys[n - 1 - i] = keys[i];
+    }
+    for (size_t i = 0; i < 100 && i < n / 2; i++) {
+      keys[n / 2 + i] = keys[0];
+    }
+    for (bool sorted : {false, true}) {
+      Filter filter(n);
+      Status s = sorted ? filter.AddAllSorted(keys.data(), 0, n)
+                        : filter.AddAll(keys, 0, n);
+      assert(s == Ok);
+      for (uint64_t k : keys) {
+        assert(filter.Contain(k) == Ok);
+      }
+    }
+  }
+}
+
+int main() {
+  testContain<BinaryFuseFilter<uint64_t, uint8_t>>();
+  testContain<BinaryFuseFilter<uint64_t, uint16_t, SimpleMixSplit, 4>>();
+  testDuplicates<BinaryFuseFilter<uint64_t, uint8_t>>();
+  testDuplicates<BinaryFuseFilter<uint64_t, uint16_t, SimpleMixSplit, 4>>();
+  cout << "binary-fuse-tests: ok" << endl;
+  return 0;
+}
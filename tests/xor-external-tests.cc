@@ -0,0 +1,97 @@
+// Tests of the external-memory construction of xor fuse filters. Build and
+// run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "random.h"
+#include "xor_external.h"
+
+using namespace std;
+using namespace xorfusefilter;
+
+string tempPath(const char* name) {
+  return string("/tmp/xor-external-tests-") + to_string(getpid()) + "-" + name;
+}
+
+void writeKeys(const string &path, const vector<uint64_t> &keys) {
+  FILE* f = fopen(path.c_str(), "wb");
+  assert(f != nullptr);
+  assert(fwrite(keys.data(), sizeof(uint64_t), keys.size(), f) == keys.size());
+  assert(fclose(f) == 0);
+}
+
+vector<char> readFile(const string &path) {
+  FILE* f = fopen(path.c_str(), "rb");
+  assert(f != nullptr);
+  vector<char> data;
+  char buffer[1 << 16];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data.insert(data.end(), buffer, buffer + len);
+  }
+  fclose(f);
+  return data;
+}
+
+// The file written by BuildFile is byte-identical to the file saved after
+// building the same filter (same seed and shards) in memory, with one
+// shard and with several shards built in parallel.
+void testSameAsInMemory() {
+  const uint64_t seed = 12345;
+  string keysPath = tempPath("keys"), filePath = tempPath("file"),
+         savedPath = tempPath("saved");
+  for (size_t n : {1000, 2000000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n);
+    writeKeys(keysPath, keys);
+    // a small budget, so that the larger set needs several shards
+    assert(BuildFile<uint8_t>(keysPath.c_str(), filePath.c_str(), 32 << 20,
+                              "/tmp", seed) == Ok);
+    XorFuseFilter<uint64_t, uint8_t> mapped(filePath.c_str());
+    assert(n < segmentLength || mapped.shards > 1);
+    for (uint64_t k : keys) {
+      assert(mapped.Contain(k) == Ok);
+    }
+    XorFuseFilter<uint64_t, uint8_t> filter(n, mapped.shards, seed);
+    assert(filter.shards == mapped.shards);
+    assert(filter.AddAll(keys.data(), 0, n, 2) == Ok);
+    assert(filter.Save(savedPath.c_str()) == Ok);
+    assert(readFile(filePath) == readFile(savedPath));
+  }
+  unlink(keysPath.c_str());
+  unlink(filePath.c_str());
+  unlink(savedPath.c_str());
+}
+
+// An empty key file gives the same filter as an empty set in memory.
+void testEmpty() {
+  const uint64_t seed = 12345;
+  string keysPath = tempPath("keys"), filePath = tempPath("file"),
+         savedPath = tempPath("saved");
+  writeKeys(keysPath, vector<uint64_t>());
+  assert(BuildFile<uint8_t>(keysPath.c_str(), filePath.c_str(), 1 << 20,
+                            "/tmp", seed) == Ok);
+  XorFuseFilter<uint64_t, uint8_t> mapped(filePath.c_str());
+  assert(mapped.Size() == 0);
+  XorFuseFilter<uint64_t, uint8_t> filter(0, 1, seed);
+  assert(filter.AddAll(vector<uint64_t>(), 0, 0) == Ok);
+  assert(filter.Save(savedPath.c_str()) == Ok);
+  assert(readFile(filePath) == readFile(savedPath));
+  unlink(keysPath.c_str());
+  unlink(filePath.c_str());
+  unlink(savedPath.c_str());
+}
+
+int main() {
+  testSameAsInMemory();
+  testEmpty();
+  cout << "xor-external-tests: ok" << endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Tests of saving and mapping xor filters (the format of xor_file.h).
+// Build and run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "random.h"
+#include "xorfilter.h"
+#include "xor_fuse_filter.h"
+#include "xorfilter_singleheader.h"
+
+using namespace std;
+
+string tempPath(const char* name) {
+  return string("/tmp/xor-file-tests-") + to_string(getpid()) + "-" + name;
+}
+
+// A filter that is saved and mapped again finds all of its keys, and
+// answers like the original for other keys. The mapped filter does not
+// own any memory.
+template <typename Filter>
+void testRoundTrip() {
+  string path = tempPath("filter");
+  for (size_t n : {1, 1000, 100000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n);
+    vector<uint64_t> others = GenerateRandom64Fast(10000, n + 1);
+    Filter filter(n);
+    assert(filter.AddAll(keys, 0, n) == 0);
+    assert(filter.Save(path.c_str()) == 0);
+    for (bool verify : {true, false}) {
+      Filter mapped(path.c_str(), verify);
+      assert(mapped.Size() == n);
+      assert(mapped.SizeInBytes() == filter.SizeInBytes());
+      assert(mapped.Memory().data == nullptr);
+      assert(mapped.Memory().bytes == 0);
+      for (uint64_t k : keys) {
+        assert(mapped.Contain(k) == 0);
+      }
+      for (uint64_t k : others) {
+        assert(mapped.Contain(k) == filter.Contain(k));
+      }
+    }
+  }
+  unlink(path.c_str());
+}
+
+// A filter of the single-header library saved with xor8_save can be
+// mapped with xor8_map and with XorFilter.
+void testSingleHeader() {
+  string path = tempPath("xor8");
+  const size_t n = 10000;
+  vector<uint64_t> keys = GenerateRandom64Fast(n, 3);
+  xor8_t filter;
+  assert(xor8_allocate(n, &filter));
+  assert(xor8_buffered_populate(keys.data(), n, &filter));
+  assert(xor8_save(&filter, n, path.c_str()));
+  xor8_t mapped;
+  assert(xor8_map(path.c_str(), &mapped, true));
+  xorfilter::XorFilter<uint64_t, uint8_t, SimpleMixSplit> other(path.c_str());
+  assert(other.Size() == n);
+  for (uint64_t k : keys) {
+    assert(xor8_contain(k, &mapped));
+    assert(other.Contain(k) == xorfilter::Ok);
+  }
+  xor8_unmap(&mapped);
+  xor8_free(&filter);
+  unlink(path.c_str());
+}
+
+// A damaged file is rejected if the checksum is verified.
+void testDamaged() {
+  string path = tempPath("damaged");
+  vector<uint64_t> keys = GenerateRandom64Fast(1000, 4);
+  xorfilter::XorFilter<uint64_t, uint8_t> filter(keys.size());
+  assert(filter.AddAll(keys, 0, keys.size()) == xorfilter::Ok);
+  assert(filter.Save(path.c_str()) == xorfilter::Ok);
+  FILE* f = fopen(path.c_str(), "r+b");
+  assert(f != nullptr);
+  fseek(f, -1, SEEK_END);
+  int c = fgetc(f);
+  fseek(f, -1, SEEK_END);
+  fputc(c ^ 1, f);
+  fclose(f);
+  bool rejected = false;
+  try {
+    xorfilter::XorFilter<uint64_t, uint8_t> mapped(path.c_str(), true);
+  } catch (const runtime_error &) {
+    rejected = true;
+  }
+  assert(rejected);
+  unlink(path.c_str());
+}
+
+int main() {
+  testRoundTrip<xorfilter::XorFilter<uint64_t, uint8_t>>();
+  testRoundTrip<xorfilter::XorFilter<uint64_t, uint16_t>>();
+  testRoundTrip<xorfusefilter::XorFuseFilter<uint64_t, uint8_t>>();
+  testSingleHeader();
+  testDamaged();
+  cout << "xor-file-tests: ok" << endl;
+  return 0;
+}
@@ -0,0 +1,49 @@
+// Tests of the xor fuse filter. Build and run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <climits>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "random.h"
+#include "xor_fuse_filter.h"
+
+using namespace std;
+using namespace xorfusefilter;
+
+// The filter of an empty set can be built, sequentially and with shards
+// built in parallel, and is queried like any other.
+void testEmpty() {
+  vector<uint64_t> none;
+  for (size_t shards : {1, 4}) {
+    XorFuseFilter<uint64_t, uint8_t> filter(0, shards);
+    assert(filter.AddAll(none, 0, 0) == Ok);
+    assert(filter.SizeInBytes() > 0);
+    filter.Contain(1);
+    XorFuseFilter<uint64_t, uint8_t> parallel(0, shards);
+    assert(parallel.AddAll(none.data(), 0, 0, shards) == Ok);
+  }
+}
+
+// Every added key is found, for small and larger sets.
+void testContain() {
+  for (size_t n : {1, 10, 1000, 100000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n);
+    XorFuseFilter<uint64_t, uint8_t> filter(n, 4);
+    assert(filter.AddAll(keys.data(), 0, n, 4) == Ok);
+    for (uint64_t k : keys) {
+      assert(filter.Contain(k) == Ok);
+    }
+  }
+}
+
+int main() {
+  testEmpty();
+  testContain();
+  cout << "xor-fuse-tests: ok" << endl;
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Tests of the invertible Bloom lookup table. Build and run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "random.h"
+#include "xor_iblt.h"
+
+using namespace std;
+using namespace xorfilter;
+
+// Two replicas share most of their keys; after one table is subtracted
+// from the other (shipped as bytes), decoding lists exactly the keys that
+// only one of them has.
+void testDecode() {
+  const uint64_t seed = 42;
+  for (size_t difference : {0, 1, 10, 100, 1000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(100000 + difference, difference);
+    vector<uint64_t> onlyA(keys.begin(), keys.begin() + difference / 2);
+    vector<uint64_t> onlyB(keys.begin() + difference / 2,
+                           keys.begin() + difference);
+    size_t cells = XorIblt<uint64_t>::CellsFor(difference);
+    XorIblt<uint64_t> a(cells, seed), b(cells, seed);
+    a.AddAll(keys, difference, keys.size());
+    a.AddAll(onlyA, 0, onlyA.size());
+    b.AddAll(keys, difference, keys.size());
+    b.AddAll(onlyB, 0, onlyB.size());
+    vector<uint8_t> shipped(b.SizeInBytes());
+    b.Write(shipped.data());
+    XorIblt<uint64_t> received(cells, seed);
+    assert(received.Read(shipped.data(), shipped.size()) == Ok);
+    assert(a.Subtract(received) == Ok);
+    vector<uint64_t> added, removed;
+    assert(a.Decode(added, removed) == Ok);
+    sort(added.begin(), added.end());
+    sort(removed.begin(), removed.end());
+    sort(onlyA.begin(), onlyA.end());
+    sort(onlyB.begin(), onlyB.end());
+    assert(added == onlyA);
+    assert(removed == onlyB);
+  }
+}
+
+// A difference much larger than the table can not be decoded, and tables
+// of a different size or seed can not be combined.
+void testErrors() {
+  vector<uint64_t> keys = GenerateRandom64Fast(1000, 1);
+  XorIblt<uint64_t> small(XorIblt<uint64_t>::CellsFor(10), 1);
+  small.AddAll(keys, 0, keys.size());
+  vector<uint64_t> added, removed;
+  assert(small.Decode(added, removed) == NotEnoughSpace);
+  XorIblt<uint64_t> otherSeed(small.arrayLength, 2);
+  assert(small.Subtract(otherSeed) == NotSupported);
+  XorIblt<uint64_t> otherSize(small.arrayLength + 3, 1);
+  assert(small.Subtract(otherSize) == NotSupported);
+  vector<uint8_t> bytes(otherSize.SizeInBytes());
+  assert(small.Read(bytes.data(), bytes.size()) == NotSupported);
+}
+
+int main() {
+  testDecode();
+  testErrors();
+  cout << "xor-iblt-tests: ok" << endl;
+  return 0;
+}
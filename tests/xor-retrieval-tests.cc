@@ -0,0 +1,57 @@
+// Tests of the xor retrieval map. Build and run with:
+//
+//     make test
+
+#undef NDEBUG
+#include <assert.h>
+#include <iostream>
+#include <vector>
+
+#include "random.h"
+#include "xor_retrieval.h"
+
+using namespace std;
+using namespace xorfilter;
+
+// Get and GetBatch return the stored value of every key, for sets of
+// different sizes (including the empty set).
+template <int valueBits>
+void testRoundTrip() {
+  const uint32_t mask = (uint32_t) ((UINT64_C(1) << valueBits) - 1);
+  for (size_t n : {0, 1, 10, 1000, 100000}) {
+    vector<uint64_t> keys = GenerateRandom64Fast(n, n + valueBits);
+    vector<uint32_t> values(n);
+    for (size_t i = 0; i < n; i++) {
+      values[i] = (uint32_t) (keys[i] * 0x9E3779B97F4A7C15ULL >> 32);
+    }
+    XorRetrieval<uint64_t, valueBits> map(n);
+    assert(map.AddAll(keys, values, 0, n) == Ok);
+    for (size_t i = 0; i < n; i++) {
+      assert(map.Get(keys[i]) == (values[i] & mask));
+    }
+    vector<uint32_t> out(n);
+    map.GetBatch(keys.data(), n, out.data());
+    for (size_t i = 0; i < n; i++) {
+      assert(out[i] == (values[i] & mask));
+    }
+  }
+}
+
+// A set with a duplicate key can not be built.
+void testDuplicates() {
+  vector<uint64_t> keys = GenerateRandom64Fast(100, 1);
+  keys[1] = keys[0];
+  vector<uint32_t> values(keys.size(), 1);
+  XorRetrieval<uint64_t, 8> map(keys.size());
+  assert(map.AddAll(keys, values, 0, keys.size()) == NotEnoughSpace);
+}
+
+int main() {
+  testRoundTrip<1>();
+  testRoundTrip<8>();
+  testRoundTrip<13>();
+  testRoundTrip<32>();
+  testDuplicates();
+  cout << "xor-retrieval-tests: ok" << endl;
+  return 0;
+}